@@ -239,8 +239,7 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 //==============================================================================
 ResponseCurveComponent::ResponseCurveComponent(SimpleEQAudioProcessor& p) :
 audioProcessor(p),
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+pathProducer(audioProcessor.leftChannelFifo, audioProcessor.rightChannelFifo)
 {
     const auto& params = audioProcessor.getParameters();
     for ( auto param : params )
@@ -248,13 +247,26 @@ rightPathProducer(audioProcessor.rightChannelFifo)
         param ->addListener(this);
     }
     
+    bandNeedsUpdate.fill(true);
     updateChain();
+    updateAnalyzerResolution();
+    updateAnalyzerBallistics();
+    updateAnalyzerDisplay();
+    updateResponseOverlay();
     
-    startTimer(60);
+    // The processor only captures audio for the analyzer while an editor holds the fifos.
+    audioProcessor.acquireAnalyzerCapture();
+    
+    analyzerThread.setSampleRate(audioProcessor.getSampleRate());
+    analyzerThread.startThread();
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
+    // Nothing may read the fifos once they're released.
+    analyzerThread.stopThread(1000);
+    audioProcessor.releaseAnalyzerCapture();
+    
     const auto& params = audioProcessor.getParameters();
     for ( auto param : params )
     {
@@ -267,172 +279,460 @@ void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float new
     parametersChanged.set(true);
 }
 
+void PathProducer::appendHop(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& fifo, juce::AudioBuffer<float>& history)
+{
+    const auto size = hopSize;
+    
+    juce::FloatVectorOperations::copy(history.getWritePointer(0, 0),
+                                      history.getReadPointer(0, size),
+                                      history.getNumSamples() - size);
+    
+    // The new samples go straight from the ring into the end of the history.
+    auto* destination = history.getWritePointer(0, history.getNumSamples() - size);
+    
+    fifo.read(size, [&destination](const float* samples, int numSamples)
+    {
+        juce::FloatVectorOperations::copy(destination, samples, numSamples);
+        destination += numSamples;
+    });
+}
+
 void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
 {
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    if ( ! leftChannelFifo->isPrepared() || ! rightChannelFifo->isPrepared() )
+        return;
     
-    while( leftChannelFifo->getNumCompleteBuffersAvailable() > 0 )
     {
-        if ( leftChannelFifo ->getAudioBuffer(tempIncomingBuffer) )
+        const juce::SpinLock::ScopedLockType sl(ballisticsLock);
+        
+        if ( ballisticsChanged )
         {
-            auto size = tempIncomingBuffer.getNumSamples();
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, 0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
-            
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0, monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0, 0),
-                                              size);
-            
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
-            
+            fftDataGenerator.setBallistics(pendingBallistics);
+            ballisticsChanged = false;
         }
     }
     
+    // Every frame from the last pass has been turned into a path, so the resolution can change between frames here.
+    const auto newResolution = requestedResolution.load();
+    const auto currentResolution = fftDataGenerator.getResolution();
+    
+    if ( newResolution.order != currentResolution.order || newResolution.multiResolution != currentResolution.multiResolution )
+    {
+        fftDataGenerator.changeResolution(newResolution);
+        updateHopSize();
+    }
+    
+    // The mono buffers always hold a whole FFT's worth of samples, so a new hop only changes how many get shifted in per frame.
+    if ( const auto newOverlap = requestedOverlap.load(); newOverlap != overlapFraction )
+    {
+        overlapFraction = newOverlap;
+        updateHopSize();
+    }
+    
+    // One FFT per hop, whatever size the host's blocks are.
+    const auto size = hopSize;
+    const auto secondsPerFrame = float(size / sampleRate);
+    
+    /*
+     Both channels have to be analysed over the same samples. After a stall (say the editor
+     was hidden), only the last FFT's worth of samples is worth analysing, so skip the rest,
+     keeping the two fifos lined up on their newest samples.
+     */
+    const auto available = juce::jmin(leftChannelFifo->getNumSamplesAvailable(), rightChannelFifo->getNumSamplesAvailable());
+    const auto excess = available - leftMonoBuffer.getNumSamples();
+    const auto toKeep = excess > 0 ? available - (excess - excess % size) : available;
+    
+    for ( auto* fifo : { leftChannelFifo, rightChannelFifo } )
+    {
+        const auto toSkip = fifo->getNumSamplesAvailable() - toKeep;
+        if ( toSkip > 0 )
+            fifo->read(toSkip, [](const float*, int) { });
+    }
+    
+    while( leftChannelFifo->getNumSamplesAvailable() >= size && rightChannelFifo->getNumSamplesAvailable() >= size )
+    {
+        appendHop(*leftChannelFifo, leftMonoBuffer);
+        appendHop(*rightChannelFifo, rightMonoBuffer);
+        
+        fftDataGenerator.produceFFTDataForRendering(leftMonoBuffer, rightMonoBuffer, negativeInfinity, secondsPerFrame);
+    }
+    
     /*
      If there is FFT data bufferes to pull
         try and pull buffer
             generate path
      */
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
+    const auto fftSize = fftDataGenerator.getOutputFFTSize();
     
     /*
      48000 / 2048 = 23hZ -< this is the bin width;
      */
     
     const auto binWidth = sampleRate / (double)fftSize;
+    const auto showSpectrogram = spectrogramEnabled.load();
     
-    while ( leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() )
+    while ( fftDataGenerator.getNumAvailableFFTDataBlocks() )
     {
-        std::vector<float> fftData;
-        if ( leftChannelFFTDataGenerator.getFFTData(fftData) )
+        if ( ! fftDataGenerator.getFFTData(leftFFTData, rightFFTData) )
+            continue;
+        
+        if ( showSpectrogram )
+        {
+            // One column per frame, so the spectrogram scrolls at the analysis rate.
+            spectrogramGenerator.generateColumn(leftFFTData, rightFFTData, (int)fftBounds.getHeight(), fftSize, binWidth);
+        }
+        else
         {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+            leftPathGenerator.generatePath(leftFFTData, fftBounds, fftSize, binWidth, negativeInfinity);
+            rightPathGenerator.generatePath(rightFFTData, fftBounds, fftSize, binWidth, negativeInfinity);
         }
     }
     
-    /*
-     While there are paths that can be pull
-        pull as many as possible
-            display the most recent path
-     */
-    while ( pathProducer.getNumPathsAvailable() )
-    {
-        pathProducer.getPath(leftChannelFFTPath);
-    }
 }
 
-void ResponseCurveComponent::timerCallback()
+AnalyzerThread::AnalyzerThread(PathProducer& producer) :
+juce::Thread("SimpleEQ Analyzer"),
+pathProducer(producer)
+{
+}
+
+AnalyzerThread::~AnalyzerThread()
+{
+    stopThread(1000);
+}
+
+void AnalyzerThread::setAnalysisBounds(juce::Rectangle<float> newBounds)
 {
-    if ( shouldShowFFTAnalysis)
+    const juce::SpinLock::ScopedLockType sl(boundsLock);
+    analysisBounds = newBounds;
+}
+
+void AnalyzerThread::run()
+{
+    while ( ! threadShouldExit() )
     {
-        auto fftBounds = getAnalysisArea().toFloat();
-        auto sampleRate = audioProcessor.getSampleRate();
+        juce::Rectangle<float> fftBounds;
+        {
+            const juce::SpinLock::ScopedLockType sl(boundsLock);
+            fftBounds = analysisBounds;
+        }
+        
+        const auto currentSampleRate = sampleRate.load();
         
-        leftPathProducer.process(fftBounds, sampleRate);
-        rightPathProducer.process(fftBounds, sampleRate);
+        if ( enabled.load() && currentSampleRate > 0 && ! fftBounds.isEmpty() )
+        {
+            pathProducer.process(fftBounds, currentSampleRate);
+        }
+        
+        // A 512 sample hop at 48 kHz comes round about every 10 ms. Disabled, sleep until setEnabled() wakes us.
+        wait(enabled.load() ? 10 : -1);
     }
+}
+
+void ResponseCurveComponent::refresh()
+{
+    // The sample rate can change under an open editor, and the curve with it.
+    analyzerThread.setSampleRate(audioProcessor.getSampleRate());
     
-    if ( parametersChanged.compareAndSetBool(false, true) )
+    // Catches the window being minimised, which doesn't always come with a callback of its own.
+    updateAnalyzerEnablement();
+    
+    if ( parametersChanged.compareAndSetBool(false, true) || audioProcessor.getSampleRate() != curveSampleRate )
     {
         DBG( "Params changed" );
-        // Invoke update monochain
+        // Invoke update monochain; this repaints whatever part of the curve moved
         updateChain();
+        updateAnalyzerResolution();
+        updateAnalyzerBallistics();
+        updateAnalyzerDisplay();
+        updateResponseOverlay();
+    }
+    
+    if ( shouldShowFFTAnalysis && shouldShowSpectrogram && pathProducer.hasNewSpectrogramColumns() )
+    {
+        pathProducer.pullSpectrogramColumns(spectrogram);
+        repaint(getAnalysisArea());
+    }
+    else if ( shouldShowFFTAnalysis && ! shouldShowSpectrogram && pathProducer.hasNewPaths() )
+    {
+        pathProducer.pullPaths(leftChannelFFTPath, rightChannelFFTPath);
+        repaint(getAnalysisArea().expanded(1));
+    }
+    
+    // The overlay's numbers change with every block, so it's kept live while it's shown.
+    if ( shouldShowLoadStats )
+        repaint(getLoadStatsArea());
+}
+
+void ResponseCurveComponent::updateAnalyzerEnablement()
+{
+    // isShowing() is false when the window is minimised, as well as when the component is hidden.
+    analyzerThread.setEnabled(shouldShowFFTAnalysis && isShowing());
+}
+
+void ResponseCurveComponent::updateAnalyzerResolution()
+{
+    const auto index = (int)audioProcessor.apvts.getRawParameterValue("Analyzer Resolution")->load();
+    
+    // The choice after the single FFT sizes is multi-resolution, which runs the shortest FFT every hop.
+    if ( index >= (int)std::size(fftOrders) )
+        pathProducer.setResolution({ fftOrders[0], true });
+    else
+        pathProducer.setResolution({ fftOrders[juce::jmax(0, index)], false });
+    
+    // 50%, 75% or 87.5%, as the "Analyzer Overlap" choices say.
+    const auto overlapIndex = juce::jlimit(0, 2, (int)audioProcessor.apvts.getRawParameterValue("Analyzer Overlap")->load());
+    pathProducer.setOverlap(1.0 - 1.0 / double(2 << overlapIndex));
+}
+
+void ResponseCurveComponent::updateAnalyzerBallistics()
+{
+    const auto index = juce::jlimit(0, 4, (int)audioProcessor.apvts.getRawParameterValue("Analyzer Ballistics")->load());
+    
+    if ( index == analyzerBallisticsIndex )
+        return;
+    
+    analyzerBallisticsIndex = index;
+    
+    // The time constants keep their defaults; only what's shown is up to the user.
+    SpectrumBallistics::Settings settings;
+    settings.display = static_cast<SpectrumBallistics::Display>(index);
+    pathProducer.setBallistics(settings);
+}
+
+namespace
+{
+// Where one band's response goes. The complex gain and group delay are only wanted while the overlay shows them.
+struct BandResponseTargets
+{
+    double* power;
+    double* re = nullptr;
+    double* im = nullptr;
+    double* groupDelay = nullptr;
+};
+
+// Multiplies in the filter's squared gain (and complex gain), and adds its group delay, at each of the evaluator's frequencies.
+template<typename FilterType>
+void applyFilterResponse(const FilterType& filter, const FrequencyResponseEvaluator& evaluator, const BandResponseTargets& targets)
+{
+    const auto& coefficients = *filter.coefficients;
+    evaluator.multiplyPowerResponse(coefficients, targets.power);
+    
+    if ( targets.re != nullptr )
+        evaluator.multiplyComplexResponse(coefficients, targets.re, targets.im);
+    
+    if ( targets.groupDelay != nullptr )
+        evaluator.addGroupDelay(coefficients, targets.groupDelay);
+}
+
+template<typename CutFilterType>
+void applyCutFilterResponse(const CutFilterType& cut, const FrequencyResponseEvaluator& evaluator, const BandResponseTargets& targets)
+{
+    if ( ! cut.template isBypassed<0>() )
+        applyFilterResponse(cut.template get<0>(), evaluator, targets);
+    if ( ! cut.template isBypassed<1>() )
+        applyFilterResponse(cut.template get<1>(), evaluator, targets);
+    if ( ! cut.template isBypassed<2>() )
+        applyFilterResponse(cut.template get<2>(), evaluator, targets);
+    if ( ! cut.template isBypassed<3>() )
+        applyFilterResponse(cut.template get<3>(), evaluator, targets);
+}
+
+// The overlay's vertical scales: phase wraps at +-180 degrees, and group delay is shown from 0 to 20 ms.
+const double maxOverlayGroupDelayMs = 20.0;
+
+// Whether anything that shapes one band's part of the response differs between the two.
+bool bandSettingsDiffer(ChainPositions band, const ChainSettings& a, const ChainSettings& b)
+{
+    switch ( band )
+    {
+        case ChainPositions::LowCut:
+            return a.lowCutFreq != b.lowCutFreq || a.lowCutSlope != b.lowCutSlope || a.lowCutBypassed != b.lowCutBypassed;
+        case ChainPositions::PeakOne:
+            return a.peakOneFreq != b.peakOneFreq || a.peakOneGainInDecibels != b.peakOneGainInDecibels
+                || a.peakOneQuality != b.peakOneQuality || a.peakOneBypassed != b.peakOneBypassed;
+        case ChainPositions::PeakTwo:
+            return a.peakTwoFreq != b.peakTwoFreq || a.peakTwoGainInDecibels != b.peakTwoGainInDecibels
+                || a.peakTwoQuality != b.peakTwoQuality || a.peakTwoBypassed != b.peakTwoBypassed;
+        case ChainPositions::PeakThree:
+            return a.peakThreeFreq != b.peakThreeFreq || a.peakThreeGainInDecibels != b.peakThreeGainInDecibels
+                || a.peakThreeQuality != b.peakThreeQuality || a.peakThreeBypassed != b.peakThreeBypassed;
+        case ChainPositions::HighCut:
+            return a.highCutFreq != b.highCutFreq || a.highCutSlope != b.highCutSlope || a.highCutBypassed != b.highCutBypassed;
+    }
+    
+    return true;
+}
+}
+
+void ResponseCurveComponent::updateAnalyzerDisplay()
+{
+    const auto showSpectrogram = audioProcessor.apvts.getRawParameterValue("Analyzer Display")->load() > 0.5f;
+    const auto historyIndex = juce::jlimit(0, 2, (int)audioProcessor.apvts.getRawParameterValue("Spectrogram History")->load());
+    
+    // 256, 512 or 1024 frames, as the parameter's choices say.
+    spectrogramHistory = 256 << historyIndex;
+    spectrogram.prepare(spectrogramHistory, getAnalysisArea().getHeight());
+    
+    if ( showSpectrogram != shouldShowSpectrogram )
+    {
+        shouldShowSpectrogram = showSpectrogram;
+        pathProducer.setSpectrogramEnabled(showSpectrogram);
+        repaint(getAnalysisArea().expanded(1));
     }
-    // Signal a repaint
-    repaint();
 }
 
 void ResponseCurveComponent::updateChain()
 {
     // Update the monochain and parameter data when load
     auto chainSettings = getChainSettings(audioProcessor.apvts);
+    const auto sampleRate = audioProcessor.getSampleRate();
+    const auto sampleRateChanged = sampleRate != curveSampleRate;
     
-    monoChain.setBypassed<ChainPositions::PeakOne>(chainSettings.peakOneBypassed);
-    monoChain.setBypassed<ChainPositions::PeakTwo>(chainSettings.peakTwoBypassed);
-    monoChain.setBypassed<ChainPositions::PeakThree>(chainSettings.peakThreeBypassed);
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    // Only the bands that moved are redesigned and have their part of the curve redone,
+    // so a change to an analyzer-only parameter costs nothing here.
+    auto bandChanged = [&](ChainPositions band)
+    {
+        if ( ! sampleRateChanged && ! bandSettingsDiffer(band, chainSettings, curveChainSettings) )
+            return false;
+        
+        bandNeedsUpdate[(size_t)band] = true;
+        return true;
+    };
+    
+    if ( bandChanged(ChainPositions::LowCut) )
+    {
+        // The same rule the processor uses, so the curve never shows a roll-off the audio doesn't have.
+        monoChain.setBypassed<ChainPositions::LowCut>(! chainSettings.isLowCutActive());
+        updateCutFilter(monoChain.get<ChainPositions::LowCut>(), makeLowCutFiler<float>(chainSettings, sampleRate), chainSettings.lowCutSlope);
+    }
+    
+    if ( bandChanged(ChainPositions::PeakOne) )
+    {
+        monoChain.setBypassed<ChainPositions::PeakOne>(chainSettings.peakOneBypassed);
+        updateCoefficients(monoChain.get<ChainPositions::PeakOne>().coefficients, makePeakOneFilter<float>(chainSettings, sampleRate));
+    }
     
-    auto peakOneCoefficients = makePeakOneFilter(chainSettings, audioProcessor.getSampleRate());
-    auto peakTwoCoefficients = makePeakTwoFilter(chainSettings, audioProcessor.getSampleRate());
-    auto peakThreeCoefficients = makePeakThreeFilter(chainSettings, audioProcessor.getSampleRate());
+    if ( bandChanged(ChainPositions::PeakTwo) )
+    {
+        monoChain.setBypassed<ChainPositions::PeakTwo>(chainSettings.peakTwoBypassed);
+        updateCoefficients(monoChain.get<ChainPositions::PeakTwo>().coefficients, makePeakTwoFilter<float>(chainSettings, sampleRate));
+    }
+    
+    if ( bandChanged(ChainPositions::PeakThree) )
+    {
+        monoChain.setBypassed<ChainPositions::PeakThree>(chainSettings.peakThreeBypassed);
+        updateCoefficients(monoChain.get<ChainPositions::PeakThree>().coefficients, makePeakThreeFilter<float>(chainSettings, sampleRate));
+    }
     
-    updateCoefficients(monoChain.get<ChainPositions::PeakOne>().coefficients, peakOneCoefficients);
-    updateCoefficients(monoChain.get<ChainPositions::PeakTwo>().coefficients, peakTwoCoefficients);
-    updateCoefficients(monoChain.get<ChainPositions::PeakThree>().coefficients, peakThreeCoefficients);
+    if ( bandChanged(ChainPositions::HighCut) )
+    {
+        monoChain.setBypassed<ChainPositions::HighCut>(! chainSettings.isHighCutActive());
+        updateCutFilter(monoChain.get<ChainPositions::HighCut>(), makeHighCutFilter<float>(chainSettings, sampleRate), chainSettings.highCutSlope);
+    }
     
-    auto lowCutCoefficients = makeLowCutFiler(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    curveChainSettings = chainSettings;
+    curveSampleRate = sampleRate;
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients, chainSettings.highCutSlope);
+    updateResponseCurve();
 }
 
-void ResponseCurveComponent::paint (juce::Graphics& g)
+void ResponseCurveComponent::updateResponseCurve()
 {
     using namespace juce;
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (Colours::black);
     
-    g.drawImage(background, getLocalBounds().toFloat());
-
     auto responseArea = getAnalysisArea();
-    auto responseWidth = responseArea.getWidth();
-    
-    auto& lowCut = monoChain.get<ChainPositions::LowCut>();
-    auto& peakOne = monoChain.get<ChainPositions::PeakOne>();
-    auto& peakTwo = monoChain.get<ChainPositions::PeakTwo>();
-    auto& peakThree = monoChain.get<ChainPositions::PeakThree>();
-    auto& highCut = monoChain.get<ChainPositions::HighCut>();
+    const auto responseWidth = (size_t)jmax(0, responseArea.getWidth());
     
-    auto sampleRate = audioProcessor.getSampleRate();
-    
-    std::vector<double> magnitudes;
+    if ( responseFrequencies.size() != responseWidth || responseEvaluator.getSampleRate() != curveSampleRate )
+    {
+        responseFrequencies.resize(responseWidth);
+        
+        for ( size_t i = 0; i < responseWidth; ++i )
+            responseFrequencies[i] = mapToLog10(double(i) / double(responseWidth), 20.0, 20000.0);
+        
+        responseEvaluator.prepare(responseFrequencies, curveSampleRate);
+        bandNeedsUpdate.fill(true);
+    }
     
-    magnitudes.resize(responseWidth);
+    bool anyBandUpdated = false;
     
-    for ( int i = 0; i < responseWidth; ++i )
+    for ( int band = 0; band < numBands; ++band )
     {
-        double magnitude = 1.f;
-        auto freq = mapToLog10(double(i) / double(responseWidth), 20.0, 20000.0);
-    
-        if (! monoChain.isBypassed<ChainPositions::PeakOne>() )
-            magnitude *= peakOne.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        if (! monoChain.isBypassed<ChainPositions::PeakTwo>() )
-            magnitude *= peakTwo.coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        if (! monoChain.isBypassed<ChainPositions::PeakThree>() )
-            magnitude *= peakThree.coefficients->getMagnitudeForFrequency(freq, sampleRate);
+        if ( ! bandNeedsUpdate[(size_t)band] )
+            continue;
+        
+        anyBandUpdated = true;
         
-        if ( !monoChain.isBypassed<ChainPositions::LowCut>() )
+        // Squared gains to start with, which saves a square root per column.
+        auto& magnitudes = bandMagnitudes[(size_t)band];
+        magnitudes.assign(responseWidth, 1.0);
+        BandResponseTargets targets { magnitudes.data() };
+        
+        if ( responseOverlay == ResponseOverlay::Phase )
+        {
+            bandResponseRe[(size_t)band].assign(responseWidth, 1.0);
+            bandResponseIm[(size_t)band].assign(responseWidth, 0.0);
+            targets.re = bandResponseRe[(size_t)band].data();
+            targets.im = bandResponseIm[(size_t)band].data();
+        }
+        else if ( responseOverlay == ResponseOverlay::GroupDelay )
         {
-            if ( !lowCut.isBypassed<0>() )
-                magnitude *= lowCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !lowCut.isBypassed<1>() )
-                magnitude *= lowCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !lowCut.isBypassed<2>() )
-                magnitude *= lowCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !lowCut.isBypassed<3>() )
-                magnitude *= lowCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
+            bandGroupDelays[(size_t)band].assign(responseWidth, 0.0);
+            targets.groupDelay = bandGroupDelays[(size_t)band].data();
         }
         
-        if ( !monoChain.isBypassed<ChainPositions::HighCut>() )
+        switch ( band )
         {
-            if ( !highCut.isBypassed<0>() )
-                magnitude *= highCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !highCut.isBypassed<1>() )
-                magnitude *= highCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !highCut.isBypassed<2>() )
-                magnitude *= highCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if ( !highCut.isBypassed<3>() )
-                magnitude *= highCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
+            case ChainPositions::LowCut:
+                if ( ! monoChain.isBypassed<ChainPositions::LowCut>() )
+                    applyCutFilterResponse(monoChain.get<ChainPositions::LowCut>(), responseEvaluator, targets);
+                break;
+            case ChainPositions::PeakOne:
+                if ( ! monoChain.isBypassed<ChainPositions::PeakOne>() )
+                    applyFilterResponse(monoChain.get<ChainPositions::PeakOne>(), responseEvaluator, targets);
+                break;
+            case ChainPositions::PeakTwo:
+                if ( ! monoChain.isBypassed<ChainPositions::PeakTwo>() )
+                    applyFilterResponse(monoChain.get<ChainPositions::PeakTwo>(), responseEvaluator, targets);
+                break;
+            case ChainPositions::PeakThree:
+                if ( ! monoChain.isBypassed<ChainPositions::PeakThree>() )
+                    applyFilterResponse(monoChain.get<ChainPositions::PeakThree>(), responseEvaluator, targets);
+                break;
+            case ChainPositions::HighCut:
+                if ( ! monoChain.isBypassed<ChainPositions::HighCut>() )
+                    applyCutFilterResponse(monoChain.get<ChainPositions::HighCut>(), responseEvaluator, targets);
+                break;
         }
         
-        magnitudes[i] = Decibels::gainToDecibels(magnitude);
+        // In dB the bands add up, so the total is just a sum. Floored at -100 dB, as gainToDecibels() would.
+        for ( auto& magnitude : magnitudes )
+            magnitude = 10.0 * std::log10(jmax(magnitude, 1.0e-10));
+        
+        bandNeedsUpdate[(size_t)band] = false;
+    }
+    
+    if ( ! anyBandUpdated )
+        return;
+    
+    responseMagnitudes.assign(responseWidth, 0.0);
+    
+    for ( const auto& magnitudes : bandMagnitudes )
+        FloatVectorOperations::add(responseMagnitudes.data(), magnitudes.data(), (int)responseWidth);
+    
+    // Wherever the curve was and wherever it goes needs repainting, and nothing else.
+    const auto oldBounds = responseCurveOutline.getBounds();
+    responseCurveOutline.clear();
+    
+    if ( responseMagnitudes.empty() )
+    {
+        repaint(oldBounds.getSmallestIntegerContainer().expanded(1));
+        return;
     }
     
     Path responseCurve;
+    responseCurve.preallocateSpace(3 * (int)responseWidth);
     
     const double outputMin = responseArea.getBottom();
     const double outputMax = responseArea.getY();
@@ -442,35 +742,222 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
         //return jmap(input, -24.5, 24.5, outputMin, outputMax);
     };
     
+    responseCurve.startNewSubPath(responseArea.getX(), map(responseMagnitudes.front()));
+    
+    for ( size_t i = 1; i < responseMagnitudes.size(); ++i )
+    {
+        responseCurve.lineTo(responseArea.getX() + i,  map(responseMagnitudes[i]));
+    }
+    
+    PathStrokeType(2.f).createStrokedPath(responseCurveOutline, responseCurve);
     
-    responseCurve.startNewSubPath(responseArea.getX(), map(magnitudes.front()));
+    repaint(oldBounds.getUnion(responseCurveOutline.getBounds()).getSmallestIntegerContainer().expanded(1));
     
-    for ( size_t i = 1; i < magnitudes.size(); ++i )
+    updateResponseOverlayOutline(responseArea);
+}
+
+void ResponseCurveComponent::updateResponseOverlayOutline(juce::Rectangle<int> responseArea)
+{
+    using namespace juce;
+    
+    const auto oldBounds = responseOverlayOutline.getBounds();
+    responseOverlayOutline.clear();
+    
+    const auto responseWidth = responseMagnitudes.size();
+    
+    if ( responseOverlay == ResponseOverlay::None || responseWidth == 0 )
+    {
+        repaint(oldBounds.getSmallestIntegerContainer().expanded(1));
+        return;
+    }
+    
+    auto& values = responseOverlayValues;
+    double minValue, maxValue;
+    
+    if ( responseOverlay == ResponseOverlay::Phase )
+    {
+        // The chain's complex gain is the product of the bands', so its phase is one atan2 per column.
+        auto& re = values;
+        auto& im = responseOverlayIm;
+        re = bandResponseRe.front();
+        im = bandResponseIm.front();
+        
+        for ( size_t band = 1; band < bandResponseRe.size(); ++band )
+        {
+            const auto *bandRe = bandResponseRe[band].data(), *bandIm = bandResponseIm[band].data();
+            
+            for ( size_t i = 0; i < responseWidth; ++i )
+            {
+                const auto r = re[i];
+                re[i] = r * bandRe[i] - im[i] * bandIm[i];
+                im[i] = r * bandIm[i] + im[i] * bandRe[i];
+            }
+        }
+        
+        for ( size_t i = 0; i < responseWidth; ++i )
+            values[i] = std::atan2(im[i], re[i]);
+        
+        minValue = -MathConstants<double>::pi;
+        maxValue = MathConstants<double>::pi;
+    }
+    else
     {
-        responseCurve.lineTo(responseArea.getX() + i,  map(magnitudes[i]));
+        // Group delays add up, like the dB magnitudes.
+        values.assign(responseWidth, 0.0);
+        
+        for ( const auto& delays : bandGroupDelays )
+            FloatVectorOperations::add(values.data(), delays.data(), (int)responseWidth);
+        
+        // Before the processor is prepared there's no sample rate, and the curve is flat anyway.
+        const auto msPerSample = curveSampleRate > 0.0 ? 1000.0 / curveSampleRate : 0.0;
+        FloatVectorOperations::multiply(values.data(), msPerSample, (int)responseWidth);
+        
+        minValue = 0.0;
+        maxValue = maxOverlayGroupDelayMs;
     }
     
-    if ( shouldShowFFTAnalysis )
+    const double outputMin = responseArea.getBottom();
+    const double outputMax = responseArea.getY();
+    auto map = [minValue, maxValue, outputMin, outputMax] (double input)
+    {
+        return jmap(jlimit(minValue, maxValue, input), minValue, maxValue, outputMin, outputMax);
+    };
+    
+    Path overlay;
+    overlay.preallocateSpace(3 * (int)responseWidth);
+    overlay.startNewSubPath(responseArea.getX(), map(values.front()));
+    
+    for ( size_t i = 1; i < responseWidth; ++i )
+    {
+        // Where the phase wraps, the line is broken rather than drawn across the whole area.
+        if ( responseOverlay == ResponseOverlay::Phase && std::abs(values[i] - values[i - 1]) > MathConstants<double>::pi )
+            overlay.startNewSubPath(responseArea.getX() + i, map(values[i]));
+        else
+            overlay.lineTo(responseArea.getX() + i, map(values[i]));
+    }
+    
+    PathStrokeType(1.5f).createStrokedPath(responseOverlayOutline, overlay);
+    
+    repaint(oldBounds.getUnion(responseOverlayOutline.getBounds()).getSmallestIntegerContainer().expanded(1));
+}
+
+void ResponseCurveComponent::updateResponseOverlay()
+{
+    const auto index = juce::jlimit(0, 2, (int)audioProcessor.apvts.getRawParameterValue("Response Overlay")->load());
+    const auto overlay = static_cast<ResponseOverlay>(index);
+    
+    if ( overlay == responseOverlay )
+        return;
+    
+    responseOverlay = overlay;
+    
+    // The bands' complex gains or delays weren't kept while they weren't shown.
+    bandNeedsUpdate.fill(true);
+    updateResponseCurve();
+    
+    // The scale's label as well as the line.
+    repaint(getAnalysisArea());
+}
+
+void ResponseCurveComponent::paint (juce::Graphics& g)
+{
+    using namespace juce;
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll (Colours::black);
+    
+    g.drawImage(background, getLocalBounds().toFloat());
+
+    auto responseArea = getAnalysisArea();
+    
+    if ( shouldShowFFTAnalysis && shouldShowSpectrogram )
+    {
+        spectrogram.draw(g, responseArea);
+    }
+    else if ( shouldShowFFTAnalysis )
     {
         // ChannelFFTPath now fits within the correct response area
-        auto leftChannelFFTPath = leftPathProducer.getPath();
-        leftChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY() - 10.f));
+        const auto toResponseArea = AffineTransform::translation(responseArea.getX(), responseArea.getY() - 10.f);
         
         g.setColour(Colours::skyblue);
-        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
-        
-        auto rightChannelFFTPath = rightPathProducer.getPath();
-        rightChannelFFTPath.applyTransform(AffineTransform().translation(responseArea.getX(), responseArea.getY() - 10.f));
+        g.strokePath(leftChannelFFTPath, PathStrokeType(1.f), toResponseArea);
         
         g.setColour(Colours::lightyellow);
-        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f));
+        g.strokePath(rightChannelFFTPath, PathStrokeType(1.f), toResponseArea);
     }
     
     g.setColour(Colours::orange);
     g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
     
     g.setColour(Colours::white);
-    g.strokePath(responseCurve, PathStrokeType(2.f));
+    g.fillPath(responseCurveOutline);
+    
+    if ( responseOverlay != ResponseOverlay::None )
+    {
+        g.setColour(Colours::mediumpurple);
+        g.fillPath(responseOverlayOutline);
+        
+        g.setFont(10);
+        g.drawText(responseOverlay == ResponseOverlay::Phase ? String("phase -180 to +180 deg")
+                                                             : "group delay 0 to " + String(maxOverlayGroupDelayMs, 0) + " ms",
+                   responseArea.reduced(4).removeFromTop(12), Justification::centredRight);
+    }
+    
+    if ( shouldShowLoadStats )
+        drawLoadStats(g);
+}
+
+namespace
+{
+const int loadStatsFontHeight = 10;
+const int loadStatsLineHeight = loadStatsFontHeight + 2;
+const int numLoadStatsLines = 3;
+}
+
+juce::Rectangle<int> ResponseCurveComponent::getLoadStatsArea()
+{
+    // The text lines and the histogram under them.
+    return getAnalysisArea().reduced(4).removeFromTop(loadStatsLineHeight * (numLoadStatsLines + 1) + 8).withWidth(150);
+}
+
+void ResponseCurveComponent::drawLoadStats(juce::Graphics& g)
+{
+    using namespace juce;
+    
+    const auto stats = audioProcessor.getLoadStats().getValues();
+    
+    StringArray lines;
+    lines.add("DSP " + String(stats.lastBudgetPercent, 1) + "% (" + String(stats.lastBlockMicroseconds, 1) + " us)");
+    lines.add("worst " + String(stats.worstBudgetPercent, 1) + "% (" + String(stats.worstBlockMicroseconds, 1) + " us)");
+    lines.add("blocks " + String(stats.numBlocks) + ", redesigns " + String(stats.numRedesigns));
+    jassert( lines.size() == numLoadStatsLines );
+    
+    const int fontHeight = loadStatsFontHeight;
+    const int lineHeight = loadStatsLineHeight;
+    auto box = getLoadStatsArea();
+    
+    g.setColour(Colours::black.withAlpha(0.7f));
+    g.fillRect(box);
+    
+    auto text = box.reduced(4);
+    g.setColour(Colours::lightgrey);
+    g.setFont(fontHeight);
+    
+    for ( auto& line : lines )
+        g.drawText(line, text.removeFromTop(lineHeight), Justification::centredLeft);
+    
+    // The histogram, one bar per 10% of budget, scaled to its fullest bucket. The last bar is over budget.
+    auto histogramArea = text.removeFromTop(lineHeight);
+    const auto fullest = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+    const auto barWidth = histogramArea.getWidth() / (int)stats.histogram.size();
+    
+    for ( size_t i = 0; i < stats.histogram.size() && fullest > 0; ++i )
+    {
+        auto barHeight = jmax(1, roundToInt(histogramArea.getHeight() * (double)stats.histogram[i] / (double)fullest));
+        auto bar = histogramArea.removeFromLeft(barWidth);
+        
+        g.setColour(i + 1 == stats.histogram.size() ? Colours::red : Colours::springgreen);
+        g.fillRect(bar.removeFromBottom(barHeight).reduced(1, 0));
+    }
 }
 
 void ResponseCurveComponent::resized()
@@ -478,6 +965,13 @@ void ResponseCurveComponent::resized()
     using namespace juce;
     background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
     
+    analyzerThread.setAnalysisBounds(getAnalysisArea().toFloat());
+    spectrogram.prepare(spectrogramHistory, getAnalysisArea().getHeight());
+    
+    // Every column moves, so the whole curve is redone.
+    bandNeedsUpdate.fill(true);
+    updateResponseCurve();
+    
     Graphics g(background);
     
     Array<float> freqs
@@ -631,6 +1125,23 @@ lowCutSlopeSliderAttachent(audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlid
 highCutFreqSliderAttachment(audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
 highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlopeSlider),
 
+analyzerLeftSourceBox(*audioProcessor.apvts.getParameter("Analyzer Left Source")),
+analyzerRightSourceBox(*audioProcessor.apvts.getParameter("Analyzer Right Source")),
+analyzerResolutionBox(*audioProcessor.apvts.getParameter("Analyzer Resolution")),
+analyzerOverlapBox(*audioProcessor.apvts.getParameter("Analyzer Overlap")),
+analyzerBallisticsBox(*audioProcessor.apvts.getParameter("Analyzer Ballistics")),
+analyzerDisplayBox(*audioProcessor.apvts.getParameter("Analyzer Display")),
+spectrogramHistoryBox(*audioProcessor.apvts.getParameter("Spectrogram History")),
+responseOverlayBox(*audioProcessor.apvts.getParameter("Response Overlay")),
+analyzerLeftSourceBoxAttachment(audioProcessor.apvts, "Analyzer Left Source", analyzerLeftSourceBox),
+analyzerRightSourceBoxAttachment(audioProcessor.apvts, "Analyzer Right Source", analyzerRightSourceBox),
+analyzerResolutionBoxAttachment(audioProcessor.apvts, "Analyzer Resolution", analyzerResolutionBox),
+analyzerOverlapBoxAttachment(audioProcessor.apvts, "Analyzer Overlap", analyzerOverlapBox),
+analyzerBallisticsBoxAttachment(audioProcessor.apvts, "Analyzer Ballistics", analyzerBallisticsBox),
+analyzerDisplayBoxAttachment(audioProcessor.apvts, "Analyzer Display", analyzerDisplayBox),
+spectrogramHistoryBoxAttachment(audioProcessor.apvts, "Spectrogram History", spectrogramHistoryBox),
+responseOverlayBoxAttachment(audioProcessor.apvts, "Response Overlay", responseOverlayBox),
+
 peakOneBypassButtonAttachment(audioProcessor.apvts, "PeakOne Bypassed", peakOneBypassButton),
 peakTwoBypassButtonAttachment(audioProcessor.apvts, "PeakTwo Bypassed", peakTwoBypassButton),
 peakThreeBypassButtonAttachment(audioProcessor.apvts, "PeakThree Bypassed", peakThreeBypassButton),
@@ -754,6 +1265,9 @@ analyzerEnabledButtonAttachment(audioProcessor.apvts, "Analyzer Enabled", analyz
         }
     };
     
+    // The attachment has already set the button from the parameter, which doesn't call onClick.
+    responseCurveComponent.toggleAnalysisEnablement(analyzerEnabledButton.getToggleState());
+    
     setSize (800, 600);
 }
 
@@ -784,12 +1298,25 @@ void SimpleEQAudioProcessorEditor::resized()
     
     auto bounds = getLocalBounds();
     
-    auto analyzerEnabledArea = bounds.removeFromTop(30);
-    analyzerEnabledArea.setWidth(110);
-    analyzerEnabledArea.setX(20);
-    analyzerEnabledArea.removeFromTop(5);
+    // The display controls run along the top, left to right.
+    auto displayControlsArea = bounds.removeFromTop(30).withTrimmedLeft(10).withTrimmedRight(10);
+    displayControlsArea.removeFromTop(5);
+    
+    auto placeDisplayControl = [&displayControlsArea](juce::Component& comp, int width)
+    {
+        comp.setBounds(displayControlsArea.removeFromLeft(width));
+        displayControlsArea.removeFromLeft(4);
+    };
     
-    analyzerEnabledButton.setBounds(analyzerEnabledArea);
+    placeDisplayControl(analyzerEnabledButton, 50);
+    placeDisplayControl(analyzerLeftSourceBox, 85);
+    placeDisplayControl(analyzerRightSourceBox, 85);
+    placeDisplayControl(analyzerResolutionBox, 100);
+    placeDisplayControl(analyzerOverlapBox, 90);
+    placeDisplayControl(analyzerBallisticsBox, 85);
+    placeDisplayControl(analyzerDisplayBox, 85);
+    placeDisplayControl(spectrogramHistoryBox, 80);
+    placeDisplayControl(responseOverlayBox, 85);
     
     bounds.removeFromTop(5);
     
@@ -855,6 +1382,14 @@ std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
         &peakThreeBypassButton,
         &lowCutBypassButton,
         &highCutBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        &analyzerLeftSourceBox,
+        &analyzerRightSourceBox,
+        &analyzerResolutionBox,
+        &analyzerOverlapBox,
+        &analyzerBallisticsBox,
+        &analyzerDisplayBox,
+        &spectrogramHistoryBox,
+        &responseOverlayBox
     };
 }
@@ -18,89 +18,627 @@ enum FFTOrder
     order8192 = 13
 };
 
-template<typename BlockType>
-struct FFTDataGenerator
+// The analyzer's choices, in the order of the "Analyzer Resolution" parameter.
+constexpr FFTOrder fftOrders[] { order2048, order4096, order8192 };
+
+/**
+ What the analyzer runs: one FFT of 'order', or, in multi-resolution mode, an 'order' FFT
+ every hop for the upper bands and the longest FFT every few hops for the bass.
+ */
+struct AnalyzerResolution
 {
+    FFTOrder order = order2048;
+    bool multiResolution = false;
+};
+
+/**
+ Bulk helpers for the analyzer. Every loop body is straight-line, branch-free code over
+ contiguous floats, so the compiler turns it into SIMD; the FloatVectorOperations calls
+ already are.
+ */
+namespace SpectrumMath
+{
+    // log2 from the float's exponent plus a cubic fit of its mantissa; within 0.003 dB when used for decibels.
+    inline float fastLog2(float x) noexcept
+    {
+        juce::uint32 bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        
+        const auto exponent = (float)((int)(bits >> 23) - 127);
+        bits = (bits & 0x007fffffu) | 0x3f800000u;
+        
+        float mantissa;
+        std::memcpy(&mantissa, &bits, sizeof(mantissa));
+        
+        const auto t = mantissa - 1.f;
+        return exponent + t * (1.4208645f + t * (-0.5772507f + t * 0.1563861f));
+    }
+    
     /**
-     produces the FFT data from an audio buffer.
+     Turns squared magnitudes into decibels in place: scales them, treats NaN and infinity
+     as silence, and floors the result at negativeInfinity.
      */
-    void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
+    inline void powerToDecibels(float* data, int numValues, float powerScale, float negativeInfinity) noexcept
     {
-        const auto fftSize = getFFTSize();
+        // 10 * log10(x) == 10 * log10(2) * log2(x)
+        constexpr float decibelsPerOctave = 3.0103f;
+        const auto floorPower = std::pow(10.f, negativeInfinity / 10.f);
+        const auto maxPower = std::numeric_limits<float>::max();
         
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        juce::FloatVectorOperations::multiply(data, powerScale, numValues);
         
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
+        for( int i = 0; i < numValues; ++i )
+        {
+            // NaN fails both comparisons, so it goes to the floor along with infinity and silence.
+            const auto power = data[i];
+            const auto sanitised = (power >= floorPower && power <= maxPower) ? power : floorPower;
+            data[i] = decibelsPerOctave * fastLog2(sanitised);
+        }
+    }
+}
+
+/**
+ Per-bin spectral ballistics: exponential averaging, peak hold with decay, and min/max tracking.
+ The state persists from frame to frame and every time constant is in seconds, so a smoother
+ display doesn't need more FFTs per second, and the look doesn't change with the hop size.
+ */
+struct SpectrumBallistics
+{
+    enum class Display
+    {
+        Instant,
+        Average,
+        PeakHold,
+        Minimum,
+        Maximum
+    };
+    
+    struct Settings
+    {
+        Display display = Display::Average;
+        float averagingTimeSeconds = 0.1f;
+        float peakHoldSeconds = 1.f;
+        float peakDecayDecibelsPerSecond = 12.f;
+    };
+    
+    void prepare(int numBins)
+    {
+        for( auto* state : { &average, &peak, &peakAge, &minimum, &maximum } )
+            state->assign((size_t)numBins, 0.f);
         
-        // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
+        hasState = false;
+    }
+    
+    // Starts the min/max tracking and the averages again from the next frame.
+    void reset() { hasState = false; }
+    
+    void setSettings(const Settings& newSettings) { settings = newSettings; }
+    
+    /** Folds a new frame (in dB) into the state, then replaces it with whatever is being displayed. */
+    void process(float* frame, int numBins, float secondsPerFrame) noexcept
+    {
+        jassert( numBins <= (int)average.size() );
         
-        int numBins = (int)fftSize / 2;
+        if( ! hasState )
+        {
+            for( auto* state : { &average, &peak, &minimum, &maximum } )
+                juce::FloatVectorOperations::copy(state->data(), frame, numBins);
+            
+            juce::FloatVectorOperations::clear(peakAge.data(), numBins);
+            hasState = true;
+        }
+        
+        const auto smoothing = settings.averagingTimeSeconds > 0.f ? std::exp(-secondsPerFrame / settings.averagingTimeSeconds) : 0.f;
+        const auto decayPerFrame = settings.peakDecayDecibelsPerSecond * secondsPerFrame;
+        const auto holdSeconds = settings.peakHoldSeconds;
+        
+        auto* averageData = average.data();
+        auto* peakData = peak.data();
+        auto* peakAgeData = peakAge.data();
         
-        //normalize the fft values.
         for( int i = 0; i < numBins; ++i )
         {
-            auto v = fftData[i];
-//            fftData[i] /= (float) numBins;
-            if( !std::isinf(v) && !std::isnan(v) )
-            {
-                v /= float(numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
+            const auto value = frame[i];
+            
+            averageData[i] = value + smoothing * (averageData[i] - value);
+            
+            const auto isNewPeak = value >= peakData[i];
+            const auto age = peakAgeData[i] + secondsPerFrame;
+            const auto decayed = peakData[i] - (age > holdSeconds ? decayPerFrame : 0.f);
+            
+            peakData[i] = isNewPeak ? value : juce::jmax(decayed, value);
+            peakAgeData[i] = isNewPeak ? 0.f : age;
         }
         
-        //convert them to decibels
-        for( int i = 0; i < numBins; ++i )
+        juce::FloatVectorOperations::min(minimum.data(), minimum.data(), frame, numBins);
+        juce::FloatVectorOperations::max(maximum.data(), maximum.data(), frame, numBins);
+        
+        switch( settings.display )
         {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
+            case Display::Instant: break;
+            case Display::Average: juce::FloatVectorOperations::copy(frame, averageData, numBins); break;
+            case Display::PeakHold: juce::FloatVectorOperations::copy(frame, peakData, numBins); break;
+            case Display::Minimum: juce::FloatVectorOperations::copy(frame, minimum.data(), numBins); break;
+            case Display::Maximum: juce::FloatVectorOperations::copy(frame, maximum.data(), numBins); break;
         }
+    }
+private:
+    Settings settings;
+    std::vector<float> average, peak, peakAge, minimum, maximum;
+    bool hasState = false;
+};
+
+/**
+ Evaluates the frequency response of first and second order IIR sections at a fixed set of
+ frequencies. The e^-jw and e^-2jw terms for every frequency are worked out once in prepare(),
+ so a section is then just arithmetic over contiguous arrays (which the compiler vectorises),
+ with no trig per section. Magnitude, phase and group delay all come from the same tables.
+ */
+struct FrequencyResponseEvaluator
+{
+    void prepare(const std::vector<double>& frequencies, double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        
+        for( auto* table : { &cos1, &sin1, &cos2, &sin2 } )
+            table->resize(frequencies.size());
         
-        fftDataFifo.push(fftData);
+        for( size_t i = 0; i < frequencies.size(); ++i )
+        {
+            // Before the processor is prepared there is no sample rate; a flat response will do.
+            const auto w = sampleRate > 0.0 ? juce::MathConstants<double>::twoPi * frequencies[i] / sampleRate : 0.0;
+            cos1[i] = std::cos(w);
+            sin1[i] = std::sin(w);
+            cos2[i] = std::cos(2.0 * w);
+            sin2[i] = std::sin(2.0 * w);
+        }
     }
     
-    void changeOrder(FFTOrder newOrder)
+    size_t getNumFrequencies() const { return cos1.size(); }
+    double getSampleRate() const { return sampleRate; }
+    
+    // power[i] *= |H(e^jw)|^2 at each frequency.
+    template<typename NumericType>
+    void multiplyPowerResponse(const juce::dsp::IIR::Coefficients<NumericType>& coefficients, double* power) const noexcept
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
-        //things that need recreating should be created on the heap via std::make_unique<>
+        const auto s = getSection(coefficients);
+        const auto n = getNumFrequencies();
+        const auto *c1 = cos1.data(), *s1 = sin1.data(), *c2 = cos2.data(), *s2 = sin2.data();
         
-        order = newOrder;
-        auto fftSize = getFFTSize();
+        for( size_t i = 0; i < n; ++i )
+        {
+            const auto numRe = s.b0 + s.b1 * c1[i] + s.b2 * c2[i];
+            const auto numIm = s.b1 * s1[i] + s.b2 * s2[i];
+            const auto denRe = 1.0 + s.a1 * c1[i] + s.a2 * c2[i];
+            const auto denIm = s.a1 * s1[i] + s.a2 * s2[i];
+            
+            power[i] *= (numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm);
+        }
+    }
+    
+    // (re[i], im[i]) *= H(e^jw); the phase of a whole chain is then one atan2 of the product.
+    template<typename NumericType>
+    void multiplyComplexResponse(const juce::dsp::IIR::Coefficients<NumericType>& coefficients, double* re, double* im) const noexcept
+    {
+        const auto s = getSection(coefficients);
+        const auto n = getNumFrequencies();
+        const auto *c1 = cos1.data(), *s1 = sin1.data(), *c2 = cos2.data(), *s2 = sin2.data();
         
-        forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
+        for( size_t i = 0; i < n; ++i )
+        {
+            // e^-jkw = cos(kw) - j sin(kw)
+            const auto numRe = s.b0 + s.b1 * c1[i] + s.b2 * c2[i];
+            const auto numIm = -(s.b1 * s1[i] + s.b2 * s2[i]);
+            const auto denRe = 1.0 + s.a1 * c1[i] + s.a2 * c2[i];
+            const auto denIm = -(s.a1 * s1[i] + s.a2 * s2[i]);
+            
+            // H = num * conj(den) / |den|^2
+            const auto denPower = denRe * denRe + denIm * denIm;
+            const auto hRe = (numRe * denRe + numIm * denIm) / denPower;
+            const auto hIm = (numIm * denRe - numRe * denIm) / denPower;
+            
+            const auto r = re[i];
+            re[i] = r * hRe - im[i] * hIm;
+            im[i] = r * hIm + im[i] * hRe;
+        }
+    }
+    
+    /**
+     delay[i] += the section's group delay in samples. For a polynomial P(z) = sum p_k z^-k the
+     delay is Re( sum k p_k z^-k / P(z) ), and the section's is the numerator's minus the denominator's.
+     */
+    template<typename NumericType>
+    void addGroupDelay(const juce::dsp::IIR::Coefficients<NumericType>& coefficients, double* delay) const noexcept
+    {
+        const auto s = getSection(coefficients);
+        const auto n = getNumFrequencies();
+        const auto *c1 = cos1.data(), *s1 = sin1.data(), *c2 = cos2.data(), *s2 = sin2.data();
+        
+        for( size_t i = 0; i < n; ++i )
+        {
+            const auto numRe = s.b0 + s.b1 * c1[i] + s.b2 * c2[i];
+            const auto numIm = -(s.b1 * s1[i] + s.b2 * s2[i]);
+            const auto rampedNumRe = s.b1 * c1[i] + 2.0 * s.b2 * c2[i];
+            const auto rampedNumIm = -(s.b1 * s1[i] + 2.0 * s.b2 * s2[i]);
+            
+            const auto denRe = 1.0 + s.a1 * c1[i] + s.a2 * c2[i];
+            const auto denIm = -(s.a1 * s1[i] + s.a2 * s2[i]);
+            const auto rampedDenRe = s.a1 * c1[i] + 2.0 * s.a2 * c2[i];
+            const auto rampedDenIm = -(s.a1 * s1[i] + 2.0 * s.a2 * s2[i]);
+            
+            delay[i] += (rampedNumRe * numRe + rampedNumIm * numIm) / (numRe * numRe + numIm * numIm)
+                      - (rampedDenRe * denRe + rampedDenIm * denIm) / (denRe * denRe + denIm * denIm);
+        }
+    }
+private:
+    // Normalised so a0 == 1; a first order section has b2 == a2 == 0.
+    struct Section
+    {
+        double b0, b1, b2, a1, a2;
+    };
+    
+    template<typename NumericType>
+    static Section getSection(const juce::dsp::IIR::Coefficients<NumericType>& coefficients) noexcept
+    {
+        const auto* c = coefficients.coefficients.begin();
         
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
+        if( coefficients.getFilterOrder() == 1 )
+            return { (double)c[0], (double)c[1], 0.0, (double)c[2], 0.0 };
+        
+        jassert( coefficients.getFilterOrder() == 2 );
+        return { (double)c[0], (double)c[1], (double)c[2], (double)c[3], (double)c[4] };
+    }
+    
+    double sampleRate = 0.0;
+    std::vector<double> cos1, sin1, cos2, sin2;
+};
 
-        fftDataFifo.prepare(fftData.size());
+template<typename BlockType>
+struct FFTDataGenerator
+{
+    /**
+     produces the FFT data for both channels, one frame per call.
+     In multi-resolution mode the frame is on the long FFT's bins, whatever the current order.
+     */
+    void produceFFTDataForRendering(const juce::AudioBuffer<float>& leftAudioData,
+                                    const juce::AudioBuffer<float>& rightAudioData,
+                                    const float negativeInfinity,
+                                    const float secondsPerFrame)
+    {
+        if( multiResolution )
+        {
+            produceMultiResolutionFFTData(leftAudioData, rightAudioData, negativeInfinity);
+        }
+        else
+        {
+            analyse(order, leftAudioData, rightAudioData, leftFFTData.data(), rightFFTData.data(), negativeInfinity);
+        }
+        
+        const auto numBins = getOutputFFTSize() / 2;
+        
+        leftBallistics.process(leftFFTData.data(), numBins, secondsPerFrame);
+        rightBallistics.process(rightFFTData.data(), numBins, secondsPerFrame);
+        
+        leftFFTDataFifo.push(leftFFTData);
+        rightFFTDataFifo.push(rightFFTData);
+    }
+    
+    /**
+     Builds the FFT and window for every order, and sizes everything else for the largest,
+     so that changeOrder() never has to allocate.
+     */
+    void prepare(FFTOrder initialOrder)
+    {
+        for( auto newOrder : fftOrders )
+        {
+            auto& plan = getPlan(newOrder);
+            const auto fftSize = 1 << newOrder;
+            
+            plan.fft = std::make_unique<juce::dsp::FFT>(newOrder);
+            
+            plan.window.resize(fftSize);
+            juce::dsp::WindowingFunction<float>::fillWindowingTables(plan.window.data(), (size_t)fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
+        }
+        
+        const auto maxFFTSize = getMaxFFTSize();
+        
+        timeData.assign(maxFFTSize, {});
+        frequencyData.assign(maxFFTSize, {});
+        
+        for( auto* fftData : { &leftFFTData, &rightFFTData } )
+        {
+            fftData->clear();
+            fftData->resize(maxFFTSize * 2, 0);
+        }
+
+        leftFFTDataFifo.prepare(leftFFTData.size());
+        rightFFTDataFifo.prepare(rightFFTData.size());
+        
+        leftBallistics.prepare(maxFFTSize / 2);
+        rightBallistics.prepare(maxFFTSize / 2);
+        
+        for( auto* bins : { &shortLeftData, &shortRightData, &longLeftData, &longRightData, &longFFTWeights } )
+            bins->assign((size_t)maxFFTSize / 2, 0.f);
+        
+        order = initialOrder;
+        multiResolution = false;
+    }
+    
+    /**
+     Switches to another of the prepared FFTs; nothing is allocated.
+     Frames already in the fifos were made at the old order, so pull them first.
+     */
+    void changeOrder(FFTOrder newOrder)
+    {
+        changeResolution({ newOrder, multiResolution });
+    }
+    
+    // As changeOrder(), and picks single or multi-resolution analysis too.
+    void changeResolution(AnalyzerResolution newResolution)
+    {
+        jassert( getPlan(newResolution.order).fft != nullptr );
+        
+        if( newResolution.order == order && newResolution.multiResolution == multiResolution )
+            return;
+        
+        order = newResolution.order;
+        multiResolution = newResolution.multiResolution;
+        
+        if( multiResolution )
+            updateCrossover();
+        
+        // The bins cover different frequencies now, so the held state means nothing.
+        leftBallistics.reset();
+        rightBallistics.reset();
+    }
+    
+    void setBallistics(const SpectrumBallistics::Settings& settings)
+    {
+        leftBallistics.setSettings(settings);
+        rightBallistics.setSettings(settings);
     }
     //==============================================================================
+    FFTOrder getOrder() const { return order; }
+    AnalyzerResolution getResolution() const { return { order, multiResolution }; }
+    // The size of the FFT that runs every hop.
     int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    // The size of FFT the frames' bins correspond to.
+    int getOutputFFTSize() const { return multiResolution ? (1 << longOrder) : getFFTSize(); }
+    static constexpr int getMaxFFTSize() { return 1 << order8192; }
+    // The two channels are always pushed together, so one count does for both.
+    int getNumAvailableFFTDataBlocks() const { return leftFFTDataFifo.getNumAvailableForReading(); }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    bool getFFTData(BlockType& leftData, BlockType& rightData)
+    {
+        return leftFFTDataFifo.pull(leftData) && rightFFTDataFifo.pull(rightData);
+    }
 private:
-    FFTOrder order;
-    BlockType fftData;
-    std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    struct Plan
+    {
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::vector<float> window;
+    };
     
-    Fifo<BlockType> fftDataFifo;
+    static constexpr FFTOrder longOrder = order8192;
+    
+    FFTOrder order = order2048;
+    bool multiResolution = false;
+    BlockType leftFFTData, rightFFTData;
+    std::array<Plan, std::size(fftOrders)> plans;
+    std::vector<std::complex<float>> timeData, frequencyData;
+    SpectrumBallistics leftBallistics, rightBallistics;
+    
+    // Multi-resolution mode: the two analyses in dB, and how much of the long one goes into each output bin.
+    std::vector<float> shortLeftData, shortRightData, longLeftData, longRightData, longFFTWeights;
+    int hopsUntilLongFFT = 0;
+    
+    Fifo<BlockType> leftFFTDataFifo, rightFFTDataFifo;
+    
+    Plan& getPlan(FFTOrder planOrder) { return plans[(size_t)(planOrder - fftOrders[0])]; }
+    
+    /**
+     Analyses the newest (1 << analysisOrder) samples of both channels with one complex FFT,
+     writing their spectra in dB to leftOutput and rightOutput.
+     Left goes in the real part and right in the imaginary part; since each is real,
+     its spectrum is conjugate symmetric, which is what lets the two be pulled apart:
+     L[k] = (X[k] + conj(X[N-k])) / 2 and R[k] = (X[k] - conj(X[N-k])) / 2j.
+     */
+    void analyse(FFTOrder analysisOrder,
+                 const juce::AudioBuffer<float>& leftAudioData,
+                 const juce::AudioBuffer<float>& rightAudioData,
+                 float* leftOutput,
+                 float* rightOutput,
+                 const float negativeInfinity)
+    {
+        const auto fftSize = 1 << analysisOrder;
+        auto& plan = getPlan(analysisOrder);
+        
+        // The buffers can be longer than the FFT; it takes their newest samples.
+        const auto offset = leftAudioData.getNumSamples() - fftSize;
+        jassert( offset >= 0 && rightAudioData.getNumSamples() == leftAudioData.getNumSamples() );
+        
+        auto* left = leftAudioData.getReadPointer(0, offset);
+        auto* right = rightAudioData.getReadPointer(0, offset);
+        auto* windowTable = plan.window.data();
+        
+        // window both channels in one pass as they're packed
+        for( int i = 0; i < fftSize; ++i )
+            timeData[i] = { left[i] * windowTable[i], right[i] * windowTable[i] };
+        
+        plan.fft->perform(timeData.data(), frequencyData.data(), false);
+        
+        const int numBins = fftSize / 2;
+        
+        //separate the spectra as squared magnitudes, which saves a square root per bin
+        for( int k = 0; k < numBins; ++k )
+        {
+            const auto x = frequencyData[k];
+            const auto mirrored = std::conj(frequencyData[(fftSize - k) & (fftSize - 1)]);
+            
+            leftOutput[k] = std::norm(x + mirrored);
+            rightOutput[k] = std::norm(x - mirrored);
+        }
+        
+        // Halving separates the spectra and dividing by numBins normalises them, as before; squared here.
+        const auto scale = 0.5f / float(numBins);
+        
+        SpectrumMath::powerToDecibels(leftOutput, numBins, scale * scale, negativeInfinity);
+        SpectrumMath::powerToDecibels(rightOutput, numBins, scale * scale, negativeInfinity);
+    }
+    
+    /**
+     The long FFT is only redone every (long size / short size) hops, which gives it the same
+     overlap as the short one. That's well under half the cost of running the long FFT at the short
+     hop rate, but it's still more than the long FFT's own mode: with 2048 and 8192 it's about 1.85
+     times the FFT work, and the ballistics and paths run once per short hop, four times as often.
+     */
+    void produceMultiResolutionFFTData(const juce::AudioBuffer<float>& leftAudioData,
+                                       const juce::AudioBuffer<float>& rightAudioData,
+                                       const float negativeInfinity)
+    {
+        if( --hopsUntilLongFFT <= 0 )
+        {
+            analyse(longOrder, leftAudioData, rightAudioData, longLeftData.data(), longRightData.data(), negativeInfinity);
+            hopsUntilLongFFT = 1 << (longOrder - order);
+        }
+        
+        analyse(order, leftAudioData, rightAudioData, shortLeftData.data(), shortRightData.data(), negativeInfinity);
+        
+        stitch(shortLeftData.data(), longLeftData.data(), leftFFTData.data());
+        stitch(shortRightData.data(), longRightData.data(), rightFFTData.data());
+    }
+    
+    // Spreads the short spectrum over the long one's bins, then fades between the two by longFFTWeights.
+    void stitch(const float* shortData, const float* longData, float* output) const noexcept
+    {
+        const auto numLongBins = (1 << longOrder) / 2;
+        const auto numShortBins = getFFTSize() / 2;
+        const auto binsPerShortBin = float(1 << (longOrder - order));
+        auto* weights = longFFTWeights.data();
+        
+        for( int k = 0; k < numLongBins; ++k )
+        {
+            const auto position = float(k) / binsPerShortBin;
+            const auto index = juce::jmin((int)position, numShortBins - 2);
+            const auto shortValue = shortData[index] + (position - float(index)) * (shortData[index + 1] - shortData[index]);
+            
+            output[k] = shortValue + weights[k] * (longData[k] - shortValue);
+        }
+    }
+    
+    /**
+     The crossover sits where the short FFT has enough bins per octave to be worth using:
+     all long below crossoverStartBin of the short FFT, all short above twice that,
+     with a raised cosine on a log-frequency axis in between. Being in bins rather than Hz,
+     it gives the same resolution at any sample rate.
+     */
+    void updateCrossover()
+    {
+        constexpr float crossoverStartBin = 8.f;
+        const auto binsPerShortBin = float(1 << (longOrder - order));
+        
+        for( size_t k = 0; k < longFFTWeights.size(); ++k )
+        {
+            const auto shortBin = juce::jmax(float(k) / binsPerShortBin, crossoverStartBin);
+            const auto t = juce::jmin(std::log2(shortBin / crossoverStartBin), 1.f);
+            longFFTWeights[k] = 0.5f * (1.f + std::cos(juce::MathConstants<float>::pi * t));
+        }
+        
+        hopsUntilLongFFT = 0;
+    }
+};
+
+/**
+ Which FFT bins land on each pixel of a log-frequency axis from 20 Hz to 20 kHz: the bins whose
+ centres fall inside the pixel or, when none do, the pair of bins either side of its centre and
+ how far between them it is. Shared by the line analyzer's columns and the spectrogram's rows.
+ */
+struct LogFrequencyPixelMap
+{
+    // The map only changes with the number of pixels, the FFT size or the sample rate. Returns true if it was rebuilt.
+    bool update(int numPixels, int numBins, float binWidth)
+    {
+        if( numPixels == mappedNumPixels && numBins == mappedNumBins && binWidth == mappedBinWidth )
+            return false;
+        
+        jassert( numBins >= 2 && binWidth > 0.f );
+        pixels.resize((size_t)numPixels);
+        
+        for( int x = 0; x < numPixels; ++x )
+        {
+            const auto lowFreq = juce::mapToLog10(float(x) / float(numPixels), 20.f, 20000.f);
+            const auto highFreq = juce::mapToLog10(float(x + 1) / float(numPixels), 20.f, 20000.f);
+            
+            const auto firstBin = juce::jlimit(0, numBins - 1, (int)std::ceil(lowFreq / binWidth));
+            const auto endBin = juce::jlimit(0, numBins, (int)std::ceil(highFreq / binWidth));
+            
+            auto& pixel = pixels[(size_t)x];
+            
+            if( endBin > firstBin )
+            {
+                pixel = { firstBin, endBin - firstBin, 0.f };
+                continue;
+            }
+            
+            const auto position = juce::mapToLog10((float(x) + 0.5f) / float(numPixels), 20.f, 20000.f) / binWidth;
+            const auto lowerBin = juce::jlimit(0, numBins - 2, (int)position);
+            pixel = { lowerBin, 0, juce::jlimit(0.f, 1.f, position - float(lowerBin)) };
+        }
+        
+        mappedNumPixels = numPixels;
+        mappedNumBins = numBins;
+        mappedBinWidth = binWidth;
+        
+        return true;
+    }
+    
+    // The quietest and loudest of the pixel's bins; both the interpolated value if it's narrower than a bin.
+    juce::Range<float> getRange(const float* data, int pixelIndex) const noexcept
+    {
+        const auto& pixel = pixels[(size_t)pixelIndex];
+        auto* bins = data + pixel.firstBin;
+        
+        if( pixel.numBins == 0 )
+        {
+            const auto value = bins[0] + pixel.fraction * (bins[1] - bins[0]);
+            return { value, value };
+        }
+        
+        return juce::FloatVectorOperations::findMinAndMax(bins, pixel.numBins);
+    }
+    
+    int getNumBins(int pixelIndex) const noexcept { return pixels[(size_t)pixelIndex].numBins; }
+private:
+    struct Pixel
+    {
+        int firstBin = 0;
+        int numBins = 0;
+        float fraction = 0.f;
+    };
+    
+    std::vector<Pixel> pixels;
+    int mappedNumPixels = 0, mappedNumBins = 0;
+    float mappedBinWidth = 0.f;
 };
 
 template<typename PathType>
 struct AnalyzerPathGenerator
 {
+    // How a pixel column that covers several bins is drawn.
+    enum class ColumnReduction
+    {
+        Peak,   // one vertex at the loudest bin
+        MinMax  // a vertex at the quietest bin and one at the loudest
+    };
+    
+    void setColumnReduction(ColumnReduction newReduction) { reduction = newReduction; }
+    
     /*
-     converts 'renderData[]' into a juce::Path
+     converts 'renderData[]' into a juce::Path, with one vertex (two for MinMax) per pixel column.
+     Columns narrower than a bin, at the low end, are interpolated between their neighbouring bins.
+     renderData is expected to be sanitised already, as FFTDataGenerator does.
+     A frame that would draw exactly the same path as the last one isn't pushed, so once the
+     display has settled (on silence, say) nothing new turns up to be repainted.
      */
     void generatePath(const std::vector<float>& renderData,
                       juce::Rectangle<float> fftBounds,
@@ -110,12 +648,21 @@ struct AnalyzerPathGenerator
     {
         auto top = fftBounds.getY();
         auto bottom = fftBounds.getHeight();
-        auto width = fftBounds.getWidth();
+        auto width = (int)fftBounds.getWidth();
+        
+        if( width <= 0 )
+            return;
 
         int numBins = (int)fftSize / 2;
-
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        
+        const auto layoutChanged = columns.update(width, numBins, binWidth) || fftBounds != lastBounds;
+        lastBounds = fftBounds;
+        
+        if( layoutChanged )
+        {
+            for( auto* list : { &vertices, &lastVertices } )
+                list->reserve((size_t)width * 2);
+        }
 
         auto map = [bottom, top, negativeInfinity](float v)
         {
@@ -123,31 +670,38 @@ struct AnalyzerPathGenerator
                               negativeInfinity, 0.f,
                               float(bottom+10),   top);
         };
-
-        auto y = map(renderData[0]);
-
-//        jassert( !std::isnan(y) && !std::isinf(y) );
-        if( std::isnan(y) || std::isinf(y) )
-            y = bottom;
         
-        p.startNewSubPath(0, y);
-
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
-
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        vertices.clear();
+        
+        auto addVertex = [this](int x, float y)
         {
-            y = map(renderData[binNum]);
-
-//            jassert( !std::isnan(y) && !std::isinf(y) );
+            vertices.push_back({ (float)x, y });
+        };
 
-            if( !std::isnan(y) && !std::isinf(y) )
-            {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
-            }
+        for( int x = 0; x < width; ++x )
+        {
+            const auto range = columns.getRange(renderData.data(), x);
+            
+            if( reduction == ColumnReduction::MinMax && columns.getNumBins(x) > 1 )
+                addVertex(x, map(range.getStart()));
+            
+            addVertex(x, map(range.getEnd()));
         }
+        
+        if( ! layoutChanged && vertices == lastVertices )
+            return;
+        
+        std::swap(vertices, lastVertices);
+
+        // Reused every time; what comes back from the fifo is an old path whose storage is kept.
+        auto& p = workingPath;
+        p.clear();
+        p.preallocateSpace(3 * 2 * width);
+        
+        p.startNewSubPath(lastVertices.front());
+        
+        for( size_t i = 1; i < lastVertices.size(); ++i )
+            p.lineTo(lastVertices[i]);
 
         pathFifo.push(p);
     }
@@ -162,9 +716,137 @@ struct AnalyzerPathGenerator
         return pathFifo.pull(path);
     }
 private:
+    LogFrequencyPixelMap columns;
+    
+    ColumnReduction reduction = ColumnReduction::Peak;
+    
+    // This frame's vertices, and those of the last path pushed.
+    std::vector<juce::Point<float>> vertices, lastVertices;
+    juce::Rectangle<float> lastBounds;
+    
+    PathType workingPath;
     Fifo<PathType> pathFifo;
 };
 
+/**
+ Turns frames into spectrogram columns: the louder of the two channels, in dB, for every pixel
+ row of the display, with the lowest frequency last so it ends up at the bottom.
+ Runs on the AnalyzerThread; the columns reach the message thread through a fifo.
+ */
+struct SpectrogramColumnGenerator
+{
+    void generateColumn(const std::vector<float>& leftData,
+                        const std::vector<float>& rightData,
+                        int height,
+                        int fftSize,
+                        float binWidth)
+    {
+        if( height <= 0 )
+            return;
+        
+        rows.update(height, fftSize / 2, binWidth);
+        
+        // Only allocates when the height changes, or the first few times round the fifo.
+        workingColumn.resize((size_t)height);
+        
+        for( int row = 0; row < height; ++row )
+        {
+            const auto pixel = height - 1 - row;
+            workingColumn[(size_t)row] = juce::jmax(rows.getRange(leftData.data(), pixel).getEnd(),
+                                                    rows.getRange(rightData.data(), pixel).getEnd());
+        }
+        
+        columnFifo.push(workingColumn);
+    }
+    
+    int getNumColumnsAvailable() const { return columnFifo.getNumAvailableForReading(); }
+    bool getColumn(std::vector<float>& column) { return columnFifo.pull(column); }
+private:
+    LogFrequencyPixelMap rows;
+    std::vector<float> workingColumn;
+    Fifo<std::vector<float>> columnFifo;
+};
+
+/**
+ The spectrogram's history, kept in a circular image one pixel column per frame. A new frame
+ is written over the oldest column and nothing else is touched; drawing blits the ring in two
+ parts, oldest first, so it scrolls without ever being redrawn. The image is only allocated
+ when the history length or the height changes.
+ */
+struct SpectrogramImage
+{
+    SpectrogramImage()
+    {
+        // Silence is black, running through blue and red to yellow and white at full scale.
+        juce::ColourGradient gradient(juce::Colours::black, 0.f, 0.f, juce::Colours::white, 1.f, 0.f, false);
+        gradient.addColour(0.25, juce::Colours::navy);
+        gradient.addColour(0.5, juce::Colours::purple);
+        gradient.addColour(0.7, juce::Colours::red);
+        gradient.addColour(0.85, juce::Colours::orange);
+        gradient.addColour(0.95, juce::Colours::yellow);
+        
+        for( size_t i = 0; i < colourTable.size(); ++i )
+            colourTable[i] = gradient.getColourAtPosition(double(i) / double(colourTable.size() - 1)).getPixelARGB();
+    }
+    
+    void prepare(int numColumns, int height)
+    {
+        if( numColumns <= 0 || height <= 0 )
+            return;
+        
+        if( image.isValid() && image.getWidth() == numColumns && image.getHeight() == height )
+            return;
+        
+        image = juce::Image(juce::Image::ARGB, numColumns, height, false);
+        image.clear(image.getBounds(), juce::Colours::black);
+        writeColumn = 0;
+    }
+    
+    // Writes one column of dB values, which go from negativeInfinity to 0, over the oldest one.
+    void addColumn(const std::vector<float>& decibels, float negativeInfinity)
+    {
+        if( ! image.isValid() || (int)decibels.size() != image.getHeight() )
+            return;
+        
+        juce::Image::BitmapData pixels(image, writeColumn, 0, 1, image.getHeight(), juce::Image::BitmapData::writeOnly);
+        jassert( pixels.pixelFormat == juce::Image::ARGB );
+        
+        const auto scale = float(colourTable.size() - 1) / -negativeInfinity;
+        const auto maxIndex = (int)colourTable.size() - 1;
+        
+        for( int y = 0; y < image.getHeight(); ++y )
+        {
+            const auto index = juce::jlimit(0, maxIndex, (int)((decibels[(size_t)y] - negativeInfinity) * scale));
+            *reinterpret_cast<juce::PixelARGB*>(pixels.getPixelPointer(0, y)) = colourTable[(size_t)index];
+        }
+        
+        writeColumn = (writeColumn + 1) % image.getWidth();
+    }
+    
+    void draw(juce::Graphics& g, juce::Rectangle<int> area) const
+    {
+        if( ! image.isValid() )
+            return;
+        
+        const auto numColumns = image.getWidth();
+        const auto height = image.getHeight();
+        
+        // The oldest column is the next one to be written, so the ring starts there.
+        const auto olderWidth = numColumns - writeColumn;
+        const auto olderArea = area.removeFromLeft(juce::roundToInt(area.getWidth() * (float)olderWidth / (float)numColumns));
+        
+        g.setImageResamplingQuality(juce::Graphics::lowResamplingQuality);
+        g.drawImage(image, olderArea.getX(), olderArea.getY(), olderArea.getWidth(), olderArea.getHeight(), writeColumn, 0, olderWidth, height);
+        
+        if( writeColumn > 0 )
+            g.drawImage(image, area.getX(), area.getY(), area.getWidth(), area.getHeight(), 0, 0, writeColumn, height);
+    }
+private:
+    juce::Image image;
+    int writeColumn = 0;
+    std::array<juce::PixelARGB, 256> colourTable;
+};
+
 struct LookAndFeel : juce::LookAndFeel_V4
 {
     void drawRotarySlider (juce::Graphics&,
@@ -214,31 +896,170 @@ private:
     juce::String suffix;
 };
 
+// A combo box that fills itself with the choices of the parameter it will be attached to.
+struct ChoiceComboBox : juce::ComboBox
+{
+    ChoiceComboBox(juce::RangedAudioParameter& rap)
+    {
+        if ( auto* choiceParam = dynamic_cast<juce::AudioParameterChoice*>(&rap) )
+            addItemList(choiceParam->choices, 1);
+        else
+            jassertfalse;
+    }
+};
+
+/**
+ Turns the two analyzer channels into spectrum paths, sharing one complex FFT between them.
+ process() runs on the AnalyzerThread, pullPaths() on the message thread;
+ the two only meet in the path fifos.
+ */
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    /**
+     'overlap' is the fraction of each FFT frame shared with the next one (0.75 means a
+     new frame every quarter of the FFT size), so the analysis rate doesn't depend on the
+     host's block size.
+     */
+    PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& leftScsf,
+                 SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& rightScsf,
+                 double overlap = 0.75) :
+    leftChannelFifo(&leftScsf),
+    rightChannelFifo(&rightScsf),
+    overlapFraction(overlap),
+    requestedOverlap(overlap)
     {
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
-        monoBuffer.setSize(1, leftChannelFFTDataGenerator.getFFTSize());
+        fftDataGenerator.prepare(FFTOrder::order2048);
+        
+        // The history is kept long enough for the largest FFT, so switching to it needs no refill.
+        const auto maxFFTSize = fftDataGenerator.getMaxFFTSize();
+        leftMonoBuffer.setSize(1, maxFFTSize);
+        rightMonoBuffer.setSize(1, maxFFTSize);
+        leftFFTData.resize(maxFFTSize * 2, 0);
+        rightFFTData.resize(maxFFTSize * 2, 0);
+        updateHopSize();
     }
     void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
+    
+    // Can be called from any thread; the AnalyzerThread switches over at the start of its next pass.
+    void setResolution(AnalyzerResolution newResolution) { requestedResolution.store(newResolution); }
+    
+    // Likewise. 'newOverlap' is a fraction of the FFT size, as in the constructor.
+    void setOverlap(double newOverlap) { requestedOverlap.store(juce::jlimit(0.0, 0.95, newOverlap)); }
+    
+    // Can be called from any thread; the AnalyzerThread picks the change up on its next pass.
+    void setBallistics(const SpectrumBallistics::Settings& settings)
+    {
+        const juce::SpinLock::ScopedLockType sl(ballisticsLock);
+        pendingBallistics = settings;
+        ballisticsChanged = true;
+    }
+    
+    // Whether a path has changed since the last time they were picked up.
+    bool hasNewPaths() const
+    {
+        return leftPathGenerator.getNumPathsAvailable() > 0 || rightPathGenerator.getNumPathsAvailable() > 0;
+    }
+    
+    // Frames go to the spectrogram instead of the paths while this is on. Can be called from any thread.
+    void setSpectrogramEnabled(bool shouldBeEnabled) { spectrogramEnabled.store(shouldBeEnabled); }
+    
+    bool hasNewSpectrogramColumns() const { return spectrogramGenerator.getNumColumnsAvailable() > 0; }
+    
+    // Writes every column produced since the last call into the spectrogram. Message thread only.
+    void pullSpectrogramColumns(SpectrogramImage& spectrogram)
+    {
+        while ( spectrogramGenerator.getColumn(spectrogramColumn) )
+            spectrogram.addColumn(spectrogramColumn, negativeInfinity);
+    }
+    
+    // The analyzer's floor, in dB.
+    static constexpr float negativeInfinity = -48.f;
+    
+    // Swaps the newest finished paths, if there are any, into left and right. Message thread only.
+    void pullPaths(juce::Path& left, juce::Path& right)
+    {
+        pullLatestPath(leftPathGenerator, left);
+        pullLatestPath(rightPathGenerator, right);
+    }
 private:
     SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* leftChannelFifo;
+    SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* rightChannelFifo;
+    double overlapFraction;
+    std::atomic<double> requestedOverlap;
+    int hopSize;
+    std::atomic<AnalyzerResolution> requestedResolution { AnalyzerResolution() };
+    
+    void updateHopSize()
+    {
+        const auto fftSize = fftDataGenerator.getFFTSize();
+        hopSize = juce::jlimit(1, fftSize, juce::roundToInt(fftSize * (1.0 - overlapFraction)));
+    }
+    
+    juce::AudioBuffer<float> leftMonoBuffer, rightMonoBuffer;
     
-    juce::AudioBuffer<float> monoBuffer;
+    FFTDataGenerator<std::vector<float>> fftDataGenerator;
+    // Swapped with the generator's fifos, so they must stay alive between calls.
+    std::vector<float> leftFFTData, rightFFTData;
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    AnalyzerPathGenerator<juce::Path> leftPathGenerator, rightPathGenerator;
     
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    SpectrogramColumnGenerator spectrogramGenerator;
+    std::atomic<bool> spectrogramEnabled { false };
+    // Swapped with the generator's fifo, like the FFT data.
+    std::vector<float> spectrogramColumn;
     
-    juce::Path leftChannelFFTPath;
+    juce::SpinLock ballisticsLock;
+    SpectrumBallistics::Settings pendingBallistics;
+    bool ballisticsChanged = false;
+    
+    static void pullLatestPath(AnalyzerPathGenerator<juce::Path>& generator, juce::Path& latest)
+    {
+        while ( generator.getNumPathsAvailable() )
+            generator.getPath(latest);
+    }
+    
+    // Moves the history along by hopSize and appends that many new samples from the fifo.
+    void appendHop(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& fifo, juce::AudioBuffer<float>& history);
 };
 
+/**
+ Runs the analyzer's STFTs in the background, so the message thread only has to pick up
+ finished paths and the work doesn't grow as the host's buffer size shrinks.
+ */
+struct AnalyzerThread : juce::Thread
+{
+    explicit AnalyzerThread(PathProducer& producer);
+    ~AnalyzerThread() override;
+    
+    // These are set from the message thread.
+    void setAnalysisBounds(juce::Rectangle<float> newBounds);
+    void setSampleRate(double newSampleRate) { sampleRate.store(newSampleRate); }
+    
+    // While disabled the thread sleeps until it's enabled again.
+    void setEnabled(bool shouldBeEnabled)
+    {
+        if ( enabled.exchange(shouldBeEnabled) != shouldBeEnabled && shouldBeEnabled )
+            notify();
+    }
+    
+    void run() override;
+private:
+    PathProducer& pathProducer;
+    
+    juce::SpinLock boundsLock;
+    juce::Rectangle<float> analysisBounds;
+    std::atomic<double> sampleRate { 0.0 };
+    std::atomic<bool> enabled { true };
+};
+
+/**
+ Draws the response curve over the analyzer. Rather than repainting on a timer, it checks
+ for changes once per display refresh and repaints only what changed: the analysis area when
+ new spectrum paths arrive, the curve's bounds when the filters change. With nothing moving
+ it does no painting at all.
+ */
 struct ResponseCurveComponent: juce::Component,
-juce::AudioProcessorParameter::Listener,
-juce::Timer
+juce::AudioProcessorParameter::Listener
 {
     ResponseCurveComponent(SimpleEQAudioProcessor&);
     ~ResponseCurveComponent();
@@ -247,7 +1068,8 @@ juce::Timer
 
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override { };
    
-    void timerCallback() override;
+    // Called in step with the display's refresh.
+    void refresh();
     
     void paint (juce::Graphics& g) override;
     
@@ -256,16 +1078,72 @@ juce::Timer
     void toggleAnalysisEnablement(bool enabled)
     {
         shouldShowFFTAnalysis = enabled;
+        updateAnalyzerEnablement();
+        repaint(getRenderArea());
     }
     
+    // Double-clicking the curve shows or hides the DSP load overlay.
+    void mouseDoubleClick(const juce::MouseEvent&) override
+    {
+        shouldShowLoadStats = ! shouldShowLoadStats;
+        repaint(getLoadStatsArea());
+    }
+    
+    void visibilityChanged() override { updateAnalyzerEnablement(); }
+    void parentHierarchyChanged() override { updateAnalyzerEnablement(); }
+    
 private:
     SimpleEQAudioProcessor& audioProcessor;
     juce::Atomic<bool> parametersChanged { false };
     
-    MonoChain monoChain;
+    MonoChain<float> monoChain;
     
     void updateChain();
     
+    /**
+     The response curve is kept between paints. Each band's magnitude (in dB, at every pixel
+     column of the analysis area) is only recomputed when that band's settings, the sample rate
+     or the width change; the curve is their sum, stored already stroked so paint just fills it.
+     */
+    static constexpr int numBands = ChainPositions::HighCut + 1;
+    std::array<std::vector<double>, numBands> bandMagnitudes;
+    std::array<bool, numBands> bandNeedsUpdate;
+    std::vector<double> responseFrequencies, responseMagnitudes;
+    
+    /**
+     The phase or group delay drawn over the curve, from the same tables as the magnitudes.
+     Each band's complex gain (for phase) or group delay is only worked out while it's shown,
+     and kept alongside its magnitude so a change to one band only redoes that band.
+     */
+    enum class ResponseOverlay
+    {
+        None,
+        Phase,
+        GroupDelay
+    };
+    
+    ResponseOverlay responseOverlay = ResponseOverlay::None;
+    std::array<std::vector<double>, numBands> bandResponseRe, bandResponseIm, bandGroupDelays;
+    std::vector<double> responseOverlayValues, responseOverlayIm;
+    juce::Path responseOverlayOutline;
+    
+    // Picks up the "Response Overlay" parameter.
+    void updateResponseOverlay();
+    void updateResponseOverlayOutline(juce::Rectangle<int> responseArea);
+    ChainSettings curveChainSettings;
+    // Never a real rate, so the first updateChain() designs every band.
+    double curveSampleRate = -1.0;
+    FrequencyResponseEvaluator responseEvaluator;
+    juce::Path responseCurveOutline;
+    
+    void updateResponseCurve();
+    
+    void updateAnalyzerResolution();
+    
+    // Picks up the "Analyzer Ballistics" parameter, passing it on only when it changes.
+    void updateAnalyzerBallistics();
+    int analyzerBallisticsIndex = -1;
+    
     // Creating the frequency grid background image
     juce::Image background;
     
@@ -274,10 +1152,33 @@ private:
     
     juce::Rectangle<int> getAnalysisArea();
     
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+    
+    // The latest analyzer paths. They're picked up in refresh(), never in paint(), so a paint
+    // for some other part of the component can't take a new path without the area being repainted.
+    juce::Path leftChannelFFTPath, rightChannelFFTPath;
+    
+    // Declared after the producer it uses, so it stops before that goes away.
+    AnalyzerThread analyzerThread { pathProducer };
     
     //Flag for AnalysisEnablment check;
     bool shouldShowFFTAnalysis = true;
+    
+    // The analyzer only runs while it's switched on and there's a window showing it.
+    void updateAnalyzerEnablement();
+    
+    SpectrogramImage spectrogram;
+    bool shouldShowSpectrogram = false;
+    int spectrogramHistory = 512;
+    
+    // Picks up the "Analyzer Display" and "Spectrogram History" parameters.
+    void updateAnalyzerDisplay();
+    
+    bool shouldShowLoadStats = false;
+    juce::Rectangle<int> getLoadStatsArea();
+    void drawLoadStats(juce::Graphics& g);
+    
+    juce::VBlankAttachment vBlankAttachment { this, [this] { refresh(); } };
 };
 
 //==============================================================================
@@ -357,6 +1258,18 @@ private:
     
     AnalyzerButton analyzerEnabledButton;
     
+    ChoiceComboBox analyzerLeftSourceBox, analyzerRightSourceBox, analyzerResolutionBox, analyzerOverlapBox, analyzerBallisticsBox, analyzerDisplayBox, spectrogramHistoryBox, responseOverlayBox;
+    
+    using ComboBoxAttachment = APVTS::ComboBoxAttachment;
+    ComboBoxAttachment analyzerLeftSourceBoxAttachment,
+                       analyzerRightSourceBoxAttachment,
+                       analyzerResolutionBoxAttachment,
+                       analyzerOverlapBoxAttachment,
+                       analyzerBallisticsBoxAttachment,
+                       analyzerDisplayBoxAttachment,
+                       spectrogramHistoryBoxAttachment,
+                       responseOverlayBoxAttachment;
+    
     using ButtonAttachment = APVTS::ButtonAttachment;
     ButtonAttachment peakOneBypassButtonAttachment,
                      peakTwoBypassButtonAttachment,
@@ -22,10 +22,35 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                        )
 #endif
 {
+    analyzerLeftSource = apvts.getRawParameterValue("Analyzer Left Source");
+    analyzerRightSource = apvts.getRawParameterValue("Analyzer Right Source");
+    analyzerEnabled = apvts.getRawParameterValue("Analyzer Enabled");
+    
+    // These only change what the editor shows, so they never need the filters redesigned.
+    const juce::StringArray displayParameterIDs { "Analyzer Enabled", "Analyzer Left Source", "Analyzer Right Source",
+                                                  "Analyzer Resolution", "Analyzer Overlap", "Analyzer Ballistics",
+                                                  "Analyzer Display", "Spectrogram History", "Response Overlay" };
+    
+    for ( auto* param : getParameters() )
+    {
+        param->addListener(this);
+        
+        auto* paramWithID = dynamic_cast<juce::AudioProcessorParameterWithID*>(param);
+        affectsFilters.push_back(paramWithID == nullptr || ! displayParameterIDs.contains(paramWithID->paramID));
+    }
+
+    filterDesignThread->addProcessor(this);
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    filterDesignThread->removeProcessor(this);
+    cancelPendingUpdate();
+
+    for ( auto* param : getParameters() )
+    {
+        param->removeListener(this);
+    }
 }
 
 //==============================================================================
@@ -63,7 +88,7 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load();
 }
 
 int SimpleEQAudioProcessor::getNumPrograms()
@@ -104,13 +129,37 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     
     spec.sampleRate = sampleRate;
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    // The host sets the processing precision before prepareToPlay, so only that filter is needed until the next prepare.
+    const auto numChannels = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    
+    if ( getProcessingPrecision() == doublePrecision )
+        doubleFilter.prepare(numChannels, samplesPerBlock, sampleRate);
+    else
+        floatFilter.prepare(numChannels, samplesPerBlock, sampleRate);
+    
+    loadStats.prepare(sampleRate);
+    
+    {
+        // The design thread may be loading a kernel into the convolutions.
+        const juce::ScopedLock sl(designLock);
+        linearPhaseFilter.prepare(numChannels, samplesPerBlock, sampleRate);
+        updateFilters();
+    }
     
-    updateFilters();
+    // The host reads the latency after prepareToPlay, so it has to be right by now.
+    setLatencySamples(pendingLatencySamples.load());
     
-    leftChannelFifo.prepare(samplesPerBlock);
-    rightChannelFifo.prepare(samplesPerBlock);
+    {
+        const juce::ScopedLock sl(analyzerCaptureLock);
+        analyzerBlockSize = samplesPerBlock;
+        
+        if ( numAnalyzerCaptureHolders > 0 )
+        {
+            const SampleFifoGuard::ScopedClose closed(analyzerFifoGuard);
+            leftChannelFifo.prepare(samplesPerBlock);
+            rightChannelFifo.prepare(samplesPerBlock);
+        }
+    }
     
     osc.initialise([](float x) { return std::sin(x); });
     
@@ -132,12 +181,10 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout works, from mono up to maxNumChannels (e.g. 7.1.4 or third order ambisonics),
+    // since every channel runs through the same filters.
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+    if (numChannels < 1 || numChannels > maxNumChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -151,8 +198,20 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 }
 #endif
 
-void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+template<typename SampleType>
+ChannelParallelFilter<SampleType>& SimpleEQAudioProcessor::getChannelParallelFilter()
+{
+    if constexpr ( std::is_same_v<SampleType, float> )
+        return floatFilter;
+    else
+        return doubleFilter;
+}
+
+template<typename SampleType>
+void SimpleEQAudioProcessor::processBlockInternal(juce::AudioBuffer<SampleType>& buffer)
 {
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -166,27 +225,56 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    updateFilters();
+    auto& channelParallelFilter = getChannelParallelFilter<SampleType>();
+    
+    if ( filterSnapshots.acquireLatest() )
+        channelParallelFilter.applySnapshot(filterSnapshots.getReadSlot());
 
-    juce::dsp::AudioBlock<float> block(buffer);
+    juce::dsp::AudioBlock<SampleType> block(buffer);
     
 //    buffer.clear();
 //
 //    juce::dsp::ProcessContextReplacing<float> stereoContext(block);
 //    osc.process(stereoContext);
 //
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    // The IIR filter still takes every snapshot above, so it's up to date if the mode is switched back.
+    const auto linearPhase = filterSnapshots.getReadSlot().settings.linearPhase;
+    
+    // The convolutions aren't fed while the IIR path runs, so their history is from the last time linear phase was on.
+    if ( linearPhase && ! linearPhaseActive )
+        linearPhaseFilter.reset();
     
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    linearPhaseActive = linearPhase;
     
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if ( linearPhase )
+        linearPhaseFilter.process(block);
+    else
+        channelParallelFilter.process(block);
     
-    leftChannelFifo.update(buffer);
-    rightChannelFifo.update(buffer);
+    // The fifos ignore the block themselves when no editor holds them.
+    if ( analyzerEnabled->load() > 0.5f )
+    {
+        // One entry for both channels: while the rings are being swapped, the block is dropped from both, keeping them in step.
+        const SampleFifoGuard::ScopedEntry entry(analyzerFifoGuard);
+        
+        if ( entry.isEntered() )
+        {
+            leftChannelFifo.update(buffer, getAnalyzerChannel(analyzerLeftSource, buffer.getNumChannels()));
+            rightChannelFifo.update(buffer, getAnalyzerChannel(analyzerRightSource, buffer.getNumChannels()));
+        }
+    }
     
+    loadStats.recordBlock(juce::Time::getHighResolutionTicks() - startTicks, buffer.getNumSamples());
+}
+
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBlockInternal(buffer);
+}
+
+void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processBlockInternal(buffer);
 }
 
 //==============================================================================
@@ -195,6 +283,32 @@ bool SimpleEQAudioProcessor::hasEditor() const
     return true; // (change this to false if you choose to not supply an editor)
 }
 
+void SimpleEQAudioProcessor::acquireAnalyzerCapture()
+{
+    const juce::ScopedLock sl(analyzerCaptureLock);
+    
+    // Before the first prepareToPlay there's no block size yet; that will allocate them instead.
+    if ( numAnalyzerCaptureHolders++ == 0 && analyzerBlockSize > 0 )
+    {
+        const SampleFifoGuard::ScopedClose closed(analyzerFifoGuard);
+        leftChannelFifo.prepare(analyzerBlockSize);
+        rightChannelFifo.prepare(analyzerBlockSize);
+    }
+}
+
+void SimpleEQAudioProcessor::releaseAnalyzerCapture()
+{
+    const juce::ScopedLock sl(analyzerCaptureLock);
+    jassert( numAnalyzerCaptureHolders > 0 );
+    
+    if ( --numAnalyzerCaptureHolders == 0 )
+    {
+        const SampleFifoGuard::ScopedClose closed(analyzerFifoGuard);
+        leftChannelFifo.release();
+        rightChannelFifo.release();
+    }
+}
+
 juce::AudioProcessorEditor* SimpleEQAudioProcessor::createEditor()
 {
     return new SimpleEQAudioProcessorEditor (*this);
@@ -249,98 +363,229 @@ ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
     settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
     settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
     
+    settings.linearPhase = apvts.getRawParameterValue("Linear Phase")->load() > 0.5f;
+    settings.linearPhaseLength = static_cast<LinearPhaseLength>(apvts.getRawParameterValue("Linear Phase Length")->load());
+    
     return settings;
 }
 
-Coefficients makePeakOneFilter(const ChainSettings& chainSettings, double sampleRate)
+template<typename SampleType>
+Coefficients<SampleType> makePeakOneFilter(const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(sampleRate,
                                                         chainSettings.peakOneFreq,
                                                         chainSettings.peakOneQuality,
-                                                        juce::Decibels::decibelsToGain(chainSettings.peakOneGainInDecibels));
+                                                        juce::Decibels::decibelsToGain((SampleType)chainSettings.peakOneGainInDecibels));
 }
 
-Coefficients makePeakTwoFilter(const ChainSettings& chainSettings, double sampleRate)
+template<typename SampleType>
+Coefficients<SampleType> makePeakTwoFilter(const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(sampleRate,
                                                         chainSettings.peakTwoFreq,
                                                         chainSettings.peakTwoQuality,
-                                                        juce::Decibels::decibelsToGain(chainSettings.peakTwoGainInDecibels));
+                                                        juce::Decibels::decibelsToGain((SampleType)chainSettings.peakTwoGainInDecibels));
 }
 
-Coefficients makePeakThreeFilter(const ChainSettings& chainSettings, double sampleRate)
+template<typename SampleType>
+Coefficients<SampleType> makePeakThreeFilter(const ChainSettings& chainSettings, double sampleRate)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
+    return juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(sampleRate,
                                                         chainSettings.peakThreeFreq,
                                                         chainSettings.peakThreeQuality,
-                                                        juce::Decibels::decibelsToGain(chainSettings.peakThreeGainInDecibels));
+                                                        juce::Decibels::decibelsToGain((SampleType)chainSettings.peakThreeGainInDecibels));
 }
 
+template Coefficients<float> makePeakOneFilter<float>(const ChainSettings&, double);
+template Coefficients<float> makePeakTwoFilter<float>(const ChainSettings&, double);
+template Coefficients<float> makePeakThreeFilter<float>(const ChainSettings&, double);
+template Coefficients<double> makePeakOneFilter<double>(const ChainSettings&, double);
+template Coefficients<double> makePeakTwoFilter<double>(const ChainSettings&, double);
+template Coefficients<double> makePeakThreeFilter<double>(const ChainSettings&, double);
 
-void SimpleEQAudioProcessor::updatePeakFilters(const ChainSettings &chainSettings)
+FilterSnapshot::Biquad makeBiquad(const juce::dsp::IIR::Coefficients<double>& coefficients)
 {
-    auto peakOneCoefficients = makePeakOneFilter(chainSettings, getSampleRate());
-    auto peakTwoCoefficients = makePeakTwoFilter(chainSettings, getSampleRate());
-    auto peakThreeCoefficients = makePeakThreeFilter(chainSettings, getSampleRate());
+    FilterSnapshot::Biquad biquad;
     
-    leftChain.setBypassed<ChainPositions::PeakOne>(chainSettings.peakOneBypassed);
-    rightChain.setBypassed<ChainPositions::PeakOne>(chainSettings.peakOneBypassed);
-
-    leftChain.setBypassed<ChainPositions::PeakTwo>(chainSettings.peakTwoBypassed);
-    rightChain.setBypassed<ChainPositions::PeakTwo>(chainSettings.peakTwoBypassed);
+    jassert( coefficients.coefficients.size() == (int)biquad.size() );
+    std::copy(coefficients.coefficients.begin(), coefficients.coefficients.end(), biquad.begin());
+    
+    return biquad;
+}
 
-    leftChain.setBypassed<ChainPositions::PeakThree>(chainSettings.peakThreeBypassed);
-    rightChain.setBypassed<ChainPositions::PeakThree>(chainSettings.peakThreeBypassed);
+bool FilterSnapshot::isNearIdentity(const Biquad& biquad)
+{
+    constexpr double tolerance = 1.0e-9;
     
-    updateCoefficients(leftChain.get<ChainPositions::PeakOne>().coefficients, peakOneCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::PeakOne>().coefficients, peakOneCoefficients);
+    return std::abs(biquad[0] - 1.0) < tolerance
+        && std::abs(biquad[1] - biquad[3]) < tolerance
+        && std::abs(biquad[2] - biquad[4]) < tolerance;
+}
+
+int FilterSnapshot::computeTailLengthSamples() const
+{
+    const auto logThreshold = std::log(silenceFloor);
+    double total = 0.0;
     
-    updateCoefficients(leftChain.get<ChainPositions::PeakTwo>().coefficients, peakTwoCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::PeakTwo>().coefficients, peakTwoCoefficients);
+    for ( int i = 0; i < numSections; ++i )
+    {
+        // The poles are the roots of z^2 + a1 z + a2; the one furthest out decays slowest.
+        const auto a1 = sections[i][3];
+        const auto a2 = sections[i][4];
+        const auto discriminant = a1 * a1 - 4.0 * a2;
+        
+        auto radius = discriminant < 0.0 ? std::sqrt(a2)
+                                         : (std::abs(a1) + std::sqrt(discriminant)) * 0.5;
+        
+        if ( radius <= 0.0 )
+            continue;
+        
+        // Unstable or marginal sections never decay; the designers shouldn't produce them.
+        jassert( radius < 1.0 );
+        radius = juce::jmin(radius, 1.0 - 1.0e-9);
+        
+        // Sections in series ring one after the other, so their tails add up.
+        total += logThreshold / std::log(radius);
+    }
     
-    updateCoefficients(leftChain.get<ChainPositions::PeakThree>().coefficients, peakThreeCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::PeakThree>().coefficients, peakThreeCoefficients);
+    return (int)std::ceil(total);
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+void SimpleEQAudioProcessor::designPeakFilters(const ChainSettings &chainSettings, FilterSnapshot& snapshot)
 {
-    *old = *replacements;
+    auto addPeak = [&snapshot](ChainPositions position, const FilterSnapshot::Biquad& biquad)
+    {
+        if ( ! FilterSnapshot::isNearIdentity(biquad) )
+            snapshot.addSection(position, 0, biquad);
+    };
+    
+    if ( ! chainSettings.peakOneBypassed )
+        addPeak(ChainPositions::PeakOne, makeBiquad(*makePeakOneFilter<double>(chainSettings, getSampleRate())));
+    if ( ! chainSettings.peakTwoBypassed )
+        addPeak(ChainPositions::PeakTwo, makeBiquad(*makePeakTwoFilter<double>(chainSettings, getSampleRate())));
+    if ( ! chainSettings.peakThreeBypassed )
+        addPeak(ChainPositions::PeakThree, makeBiquad(*makePeakThreeFilter<double>(chainSettings, getSampleRate())));
 }
 
-void SimpleEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
+void SimpleEQAudioProcessor::designLowCutFilters(const ChainSettings &chainSettings, FilterSnapshot& snapshot)
 {
-    auto lowCutCoefficients = makeLowCutFiler(chainSettings, getSampleRate());
+    if ( ! chainSettings.isLowCutActive() )
+        return;
+    
+    // The design has exactly as many sections as the slope needs.
+    auto design = cutFilterCoefficientCache->getDesign(ChainPositions::LowCut, chainSettings.lowCutFreq, chainSettings.lowCutSlope, getSampleRate());
+    
+    for ( int i = 0; i < design.numSections; ++i )
+        snapshot.addSection(ChainPositions::LowCut, i, design.sections[i]);
+}
 
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+void SimpleEQAudioProcessor::designHighCutFilters(const ChainSettings &chainSettings, FilterSnapshot& snapshot)
+{
+    if ( ! chainSettings.isHighCutActive() )
+        return;
+    
+    auto design = cutFilterCoefficientCache->getDesign(ChainPositions::HighCut, chainSettings.highCutFreq, chainSettings.highCutSlope, getSampleRate());
     
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    for ( int i = 0; i < design.numSections; ++i )
+        snapshot.addSection(ChainPositions::HighCut, i, design.sections[i]);
+}
 
-    updateCutFilter(leftLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
-    updateCutFilter(rightLowCut, lowCutCoefficients, chainSettings.lowCutSlope);
+void SimpleEQAudioProcessor::updateFilters()
+{
+    const juce::ScopedLock sl(designLock);
+    
+    // Nothing to design against until the host has told us the sample rate.
+    if ( getSampleRate() <= 0 )
+        return;
+    
+    auto& snapshot = filterSnapshots.getWriteSlot();
+    snapshot.settings = getChainSettings(apvts);
+    snapshot.numSections = 0;
+    
+    designLowCutFilters(snapshot.settings, snapshot);
+    designPeakFilters(snapshot.settings, snapshot);
+    designHighCutFilters(snapshot.settings, snapshot);
+    
+    snapshot.tailLengthSamples = snapshot.computeTailLengthSamples();
+    
+    auto latencySamples = 0;
+    auto tailLengthSamples = snapshot.tailLengthSamples;
+    
+    if ( snapshot.settings.linearPhase )
+    {
+        // Convolution swaps a new kernel in on its own background thread, so for the first few blocks
+        // after this the audio still runs through the previous kernel (a pass-through, if there wasn't one)
+        // while the host has already been given the new latency. Offline renders wait it out with
+        // isLinearPhaseKernelPending(); in real time the misalignment is brief and isn't corrected.
+        const auto kernelLength = snapshot.settings.getLinearPhaseKernelLength();
+        linearPhaseFilter.loadKernel(snapshot, kernelLength, getSampleRate());
+        
+        latencySamples = LinearPhaseFilter::getLatencySamples(kernelLength);
+        tailLengthSamples = kernelLength;
+    }
+    
+    const auto newTailLengthSeconds = tailLengthSamples / getSampleRate();
+    
+    if ( tailLengthSeconds.exchange(newTailLengthSeconds) != newTailLengthSeconds )
+        tailLengthChanged.store(true);
+    
+    filterSnapshots.publish();
+    loadStats.recordRedesign();
+    
+    if ( pendingLatencySamples.exchange(latencySamples) != latencySamples || tailLengthChanged.load() )
+        triggerAsyncUpdate();
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings)
+void SimpleEQAudioProcessor::updateFiltersIfNeeded()
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
+    // The flag is cleared under the same lock the redesign holds, so isFilterUpdatePending()
+    // can never see it cleared while the snapshot is still unpublished.
+    const juce::ScopedLock sl(designLock);
     
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    if ( parametersChanged.compareAndSetBool(false, true) )
+        updateFilters();
+}
 
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+bool SimpleEQAudioProcessor::isFilterUpdatePending()
+{
+    // Holding the design lock means no redesign is halfway through.
+    const juce::ScopedLock sl(designLock);
+    return parametersChanged.get();
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+void SimpleEQAudioProcessor::parameterValueChanged(int parameterIndex, float /*newValue*/)
+{
+    // This can be called on the audio thread during automation, so only raise a flag here.
+    if ( juce::isPositiveAndBelow(parameterIndex, (int)affectsFilters.size()) && affectsFilters[(size_t)parameterIndex] )
+        parametersChanged.set(true);
+}
+
+bool SimpleEQAudioProcessor::isLinearPhaseKernelPending()
 {
     auto chainSettings = getChainSettings(apvts);
+    
+    return chainSettings.linearPhase
+        && ! linearPhaseFilter.isKernelLoaded(chainSettings.getLinearPhaseKernelLength(), getSampleRate());
+}
 
-    updateLowCutFilters(chainSettings);
-    updatePeakFilters(chainSettings);
-    updateHighCutFilters(chainSettings);
+void SimpleEQAudioProcessor::handleAsyncUpdate()
+{
+    // setLatencySamples tells the host itself when the latency changes; the tail has to be announced separately.
+    setLatencySamples(pendingLatencySamples.load());
+    
+    if ( tailLengthChanged.exchange(false) )
+        updateHostDisplay(ChangeDetails().withNonParameterStateChanged(true));
+}
+
+int SimpleEQAudioProcessor::getAnalyzerChannel(const std::atomic<float>* sourceParameter, int numChannels) const
+{
+    // Choice 0 is the downmix, choice n is channel n - 1.
+    auto channel = (int)sourceParameter->load() - 1;
+    
+    if ( channel < 0 )
+        return Channel::Downmix;
+    
+    return juce::jmin(channel, numChannels - 1);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::createParameterLayout()
@@ -389,9 +634,324 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::crea
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("HighCut Bypassed", 1), "HighCut", false));
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Analyzer Enabled", 1), "Analyzer Enabled", true));
     
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID("Linear Phase", 1), "Linear Phase", false));
+    
+    // Longer kernels resolve the low end better, at the cost of latency and CPU.
+    juce::StringArray kernelLengths;
+    for (int i = 0; i < 4; ++i)
+    {
+        juce::String str;
+        str << (4096 << i);
+        str << " samples";
+        kernelLengths.add(str);
+    }
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Linear Phase Length", 1), "Linear Phase Length", kernelLengths, 1));
+    
+    juce::StringArray analyzerSources { "Downmix" };
+    for (int i = 1; i <= maxNumChannels; ++i)
+    {
+        juce::String str;
+        str << "Channel " << i;
+        analyzerSources.add(str);
+    }
+    
+    // Defaults match the fifos' original channels: Channel::Left is index 1, Channel::Right is index 0.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Left Source", 1), "Analyzer Left Source", analyzerSources, 2));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Right Source", 1), "Analyzer Right Source", analyzerSources, 1));
+    
+    // FFT sizes for the analyzer; larger ones resolve the low end better but respond more slowly.
+    juce::StringArray analyzerResolutions;
+    for (int i = 0; i < 3; ++i)
+    {
+        juce::String str;
+        str << (2048 << i);
+        str << " point FFT";
+        analyzerResolutions.add(str);
+    }
+    
+    // A long FFT for the bass and a short one above it.
+    analyzerResolutions.add("Multi-resolution");
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Resolution", 1), "Analyzer Resolution", analyzerResolutions, 0));
+    
+    // How much each FFT frame shares with the next; more overlap means more frames per second.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Overlap", 1), "Analyzer Overlap", juce::StringArray { "50% overlap", "75% overlap", "87.5% overlap" }, 1));
+    
+    // What each analyzer bin shows, in the order of SpectrumBallistics::Display.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Ballistics", 1), "Analyzer Ballistics", juce::StringArray { "Instant", "Average", "Peak Hold", "Minimum", "Maximum" }, 1));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Analyzer Display", 1), "Analyzer Display", juce::StringArray { "Lines", "Spectrogram" }, 0));
+    
+    // How many frames the spectrogram keeps, one pixel column each.
+    juce::StringArray spectrogramHistories;
+    for (int i = 0; i < 3; ++i)
+    {
+        juce::String str;
+        str << (256 << i);
+        str << " frames";
+        spectrogramHistories.add(str);
+    }
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Spectrogram History", 1), "Spectrogram History", spectrogramHistories, 1));
+    
+    // Drawn over the response curve.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID("Response Overlay", 1), "Response Overlay", juce::StringArray { "No overlay", "Phase", "Group delay" }, 0));
+    
     return layout;
 }
 
+//==============================================================================
+CutFilterCoefficientCache::Design CutFilterCoefficientCache::getDesign(ChainPositions position, float frequency, Slope slope, double sampleRate)
+{
+    jassert( position == ChainPositions::LowCut || position == ChainPositions::HighCut );
+    
+    // The frequency parameters are quantised to 1 Hz, and sample rates are distinguished to 1/100 Hz.
+    const auto roundedFrequency = juce::roundToInt(frequency);
+    const auto key = ((juce::uint64) juce::roundToInt(sampleRate * 100.0) << 20)
+                   | ((juce::uint64) roundedFrequency << 3)
+                   | ((juce::uint64) slope << 1)
+                   | (position == ChainPositions::HighCut ? 1 : 0);
+    
+    const juce::ScopedLock sl(lock);
+    
+    if ( auto it = designs.find(key); it != designs.end() )
+        return it->second;
+    
+    ChainSettings chainSettings;
+    chainSettings.lowCutFreq = chainSettings.highCutFreq = (float)roundedFrequency;
+    chainSettings.lowCutSlope = chainSettings.highCutSlope = slope;
+    
+    auto coefficients = position == ChainPositions::LowCut ? makeLowCutFiler<double>(chainSettings, sampleRate)
+                                                           : makeHighCutFilter<double>(chainSettings, sampleRate);
+    
+    Design design;
+    design.numSections = juce::jmin(coefficients.size(), (int)design.sections.size());
+    
+    for ( int i = 0; i < design.numSections; ++i )
+        design.sections[i] = makeBiquad(*coefficients[i]);
+    
+    if ( designs.size() >= maxNumDesigns )
+        designs.clear();
+    
+    designs.emplace(key, design);
+    return design;
+}
+
+//==============================================================================
+void LinearPhaseFilter::prepare(int numChannels, int newMaximumBlockSize, double sampleRate)
+{
+    // The audio thread isn't running, so the engines can simply go. A kernel designed for the old
+    // rate would only be resampled, and could be mistaken for the new one.
+    numActivePairs.store(0);
+    
+    for ( auto& convolution : convolutions )
+        convolution.reset();
+    
+    numPairsNeeded = juce::jlimit(1, maxNumPairs, (numChannels + 1) / 2);
+    maximumBlockSize = juce::jmax(1, newMaximumBlockSize);
+    preparedSampleRate = sampleRate;
+    floatScratch.setSize(numPairsNeeded * 2, maximumBlockSize);
+}
+
+void LinearPhaseFilter::loadKernel(const FilterSnapshot& snapshot, int kernelLength, double sampleRate)
+{
+    jassert( juce::isPowerOfTwo(kernelLength) );
+    
+    // Not prepared yet, or the host has changed the rate and prepareToPlay will design again for it.
+    if ( numPairsNeeded == 0 || sampleRate != preparedSampleRate )
+        return;
+    
+    if ( isLoaded(snapshot, kernelLength) )
+        return;
+    
+    if ( fft == nullptr || fft->getSize() != kernelLength )
+    {
+        fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(kernelLength)));
+        
+        // A window one sample longer than the kernel is centred exactly on sample kernelLength / 2;
+        // its last point is zero, so nothing is lost by dropping it.
+        window.resize((size_t)kernelLength + 1);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(), window.size(),
+                                                                 juce::dsp::WindowingFunction<float>::blackman,
+                                                                 false);
+    }
+    
+    spectrum.assign((size_t)kernelLength * 2, 0.f);
+    
+    const auto numBins = kernelLength / 2 + 1;
+    
+    for ( int k = 0; k < numBins; ++k )
+    {
+        const auto z = std::polar(1.0, -juce::MathConstants<double>::twoPi * k / kernelLength);
+        const auto z2 = z * z;
+        double magnitude = 1.0;
+        
+        for ( int i = 0; i < snapshot.numSections; ++i )
+        {
+            const auto& biquad = snapshot.sections[(size_t)i];
+            magnitude *= std::abs((biquad[0] + biquad[1] * z + biquad[2] * z2) / (1.0 + biquad[3] * z + biquad[4] * z2));
+        }
+        
+        // Zero phase, then delayed by half the kernel: a phase of -pi k, which is just a sign flip on odd bins.
+        spectrum[(size_t)(2 * k)] = (float)((k & 1) ? -magnitude : magnitude);
+    }
+    
+    fft->performRealOnlyInverseTransform(spectrum.data());
+    
+    juce::AudioBuffer<float> kernel(1, kernelLength);
+    auto* kernelSamples = kernel.getWritePointer(0);
+    
+    for ( int i = 0; i < kernelLength; ++i )
+        kernelSamples[i] = spectrum[(size_t)i] * window[(size_t)i];
+    
+    // Linear phase has just been switched on, or the host re-prepared. Either way the audio thread
+    // won't use the engines until the snapshot that follows this is published.
+    if ( numActivePairs.load() == 0 )
+    {
+        juce::dsp::ProcessSpec spec;
+        spec.sampleRate = preparedSampleRate;
+        spec.maximumBlockSize = (juce::uint32)maximumBlockSize;
+        spec.numChannels = 2;
+        
+        for ( int i = 0; i < numPairsNeeded; ++i )
+        {
+            convolutions[(size_t)i] = std::make_unique<juce::dsp::Convolution>(juce::dsp::Convolution::Latency { 0 }, *messageQueue);
+            convolutions[(size_t)i]->prepare(spec);
+        }
+    }
+    
+    for ( int i = 0; i < numPairsNeeded; ++i )
+    {
+        convolutions[(size_t)i]->loadImpulseResponse(juce::AudioBuffer<float>(kernel),
+                                                     sampleRate,
+                                                     juce::dsp::Convolution::Stereo::no,
+                                                     juce::dsp::Convolution::Trim::no,
+                                                     juce::dsp::Convolution::Normalise::no);
+    }
+    
+    loadedKernelLength = kernelLength;
+    loadedNumSections = snapshot.numSections;
+    std::copy(snapshot.sections.begin(), snapshot.sections.begin() + snapshot.numSections, loadedSections.begin());
+    
+    numActivePairs.store(numPairsNeeded);
+}
+
+bool LinearPhaseFilter::isLoaded(const FilterSnapshot& snapshot, int kernelLength) const
+{
+    // The engines are dropped in prepare, and with them whatever they were given.
+    if ( numActivePairs.load() == 0 || kernelLength != loadedKernelLength || snapshot.numSections != loadedNumSections )
+        return false;
+    
+    // The kernel only depends on the sections' magnitude response, so the same sections mean the same kernel.
+    return std::equal(snapshot.sections.begin(), snapshot.sections.begin() + snapshot.numSections, loadedSections.begin());
+}
+
+bool LinearPhaseFilter::isKernelLoaded(int kernelLength, double sampleRate)
+{
+    return numActivePairs.load() > 0
+        && sampleRate == preparedSampleRate
+        && (int)convolutions[0]->getCurrentIRSize() == kernelLength;
+}
+
+void LinearPhaseFilter::reset()
+{
+    for ( int i = 0; i < numActivePairs.load(); ++i )
+        convolutions[(size_t)i]->reset();
+}
+
+void LinearPhaseFilter::process(juce::dsp::AudioBlock<float>& block)
+{
+    const auto numChannels = (int)block.getNumChannels();
+    const auto numSamples = (int)block.getNumSamples();
+    
+    // As with the IIR path, hosts may send more than they promised.
+    for ( int start = 0; start < numSamples; start += maximumBlockSize )
+    {
+        const auto segmentSize = juce::jmin(maximumBlockSize, numSamples - start);
+        auto segment = block.getSubBlock((size_t)start, (size_t)segmentSize);
+        
+        for ( int firstChannel = 0, pair = 0; firstChannel < numChannels && pair < numActivePairs.load(); firstChannel += 2, ++pair )
+        {
+            auto pairBlock = segment.getSubsetChannelBlock((size_t)firstChannel, (size_t)juce::jmin(2, numChannels - firstChannel));
+            juce::dsp::ProcessContextReplacing<float> context(pairBlock);
+            convolutions[(size_t)pair]->process(context);
+        }
+    }
+}
+
+void LinearPhaseFilter::process(juce::dsp::AudioBlock<double>& block)
+{
+    const auto numChannels = juce::jmin((int)block.getNumChannels(), floatScratch.getNumChannels());
+    const auto numSamples = (int)block.getNumSamples();
+    
+    for ( int start = 0; start < numSamples; start += maximumBlockSize )
+    {
+        const auto segmentSize = juce::jmin(maximumBlockSize, numSamples - start);
+        
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            auto* source = block.getChannelPointer((size_t)ch) + start;
+            auto* destination = floatScratch.getWritePointer(ch);
+            
+            for ( int i = 0; i < segmentSize; ++i )
+                destination[i] = (float)source[i];
+        }
+        
+        juce::dsp::AudioBlock<float> floatBlock(floatScratch.getArrayOfWritePointers(), (size_t)numChannels, (size_t)segmentSize);
+        process(floatBlock);
+        
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            auto* source = floatScratch.getReadPointer(ch);
+            auto* destination = block.getChannelPointer((size_t)ch) + start;
+            
+            for ( int i = 0; i < segmentSize; ++i )
+                destination[i] = (double)source[i];
+        }
+    }
+}
+
+//==============================================================================
+FilterDesignThread::FilterDesignThread() : juce::Thread("SimpleEQ Filter Design")
+{
+    startThread();
+}
+
+FilterDesignThread::~FilterDesignThread()
+{
+    stopThread(1000);
+}
+
+void FilterDesignThread::addProcessor(SimpleEQAudioProcessor* processor)
+{
+    const juce::ScopedLock sl(lock);
+    processors.addIfNotAlreadyThere(processor);
+}
+
+void FilterDesignThread::removeProcessor(SimpleEQAudioProcessor* processor)
+{
+    // Holding the lock here means a processor can't be destroyed while it is being redesigned.
+    const juce::ScopedLock sl(lock);
+    processors.removeFirstMatchingValue(processor);
+}
+
+void FilterDesignThread::run()
+{
+    // Polling (rather than being notified) keeps the audio thread free of any locks
+    // when parameter changes arrive from host automation.
+    while ( ! threadShouldExit() )
+    {
+        {
+            const juce::ScopedLock sl(lock);
+            for ( auto* processor : processors )
+                processor->updateFiltersIfNeeded();
+        }
+        
+        wait(5);
+    }
+}
+
 //==============================================================================
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
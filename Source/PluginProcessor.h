@@ -11,9 +11,20 @@
 #include <JuceHeader.h>
 
 #include <array>
+#include <atomic>
+#include <unordered_map>
+/**
+ A single-producer/single-consumer queue of preallocated T slots.
+ push() and pull() swap the caller's object with a slot instead of copying it, so once
+ every object in circulation has been prepared to the right size, nothing crossing
+ the queue is ever deep-copied or reallocated. Both sides should keep long-lived
+ objects to swap with, rather than fresh ones each time.
+ */
 template<typename T>
 struct Fifo
 {
+    explicit Fifo(int capacity = 30) : buffers((size_t)capacity), fifo(capacity) { }
+    
     void prepare(int numChannels, int numSamples)
     {
         static_assert( std::is_same_v<T, juce::AudioBuffer<float>>,
@@ -40,24 +51,26 @@ struct Fifo
         }
     }
     
-    bool push(const T& t)
+    // Hands t over and leaves the caller with the slot's previous object. On failure t is untouched.
+    bool push(T& t)
     {
         auto write = fifo.write(1);
         if( write.blockSize1 > 0 )
         {
-            buffers[write.startIndex1] = t;
+            std::swap(buffers[(size_t)write.startIndex1], t);
             return true;
         }
         
         return false;
     }
     
+    // Takes the oldest object, leaving the caller's previous one in its slot for the producer to reuse.
     bool pull(T& t)
     {
         auto read = fifo.read(1);
         if( read.blockSize1 > 0 )
         {
-            t = buffers[read.startIndex1];
+            std::swap(t, buffers[(size_t)read.startIndex1]);
             return true;
         }
         
@@ -69,79 +82,272 @@ struct Fifo
         return fifo.getNumReady();
     }
 private:
-    static constexpr int Capacity = 30;
-    std::array<T, Capacity> buffers;
-    juce::AbstractFifo fifo {Capacity};
+    std::vector<T> buffers;
+    juce::AbstractFifo fifo;
+};
+
+/**
+ Hands the most recent complete T from one writer thread to one reader thread.
+
+ The writer fills getWriteSlot() and calls publish(); the reader calls acquireLatest()
+ and then reads getReadSlot(). Each side only ever does a single atomic exchange,
+ so neither side can block, and a slot is never written while it is being read.
+ */
+template<typename T>
+struct TripleBuffer
+{
+    T& getWriteSlot() { return slots[writeIndex]; }
+
+    void publish()
+    {
+        writeIndex = sharedIndex.exchange(writeIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    bool acquireLatest()
+    {
+        if( (sharedIndex.load(std::memory_order_relaxed) & freshBit) == 0 )
+            return false;
+
+        readIndex = sharedIndex.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T& getReadSlot() const { return slots[readIndex]; }
+private:
+    static constexpr int freshBit = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<T, 3> slots;
+    int writeIndex = 0, readIndex = 1;
+    std::atomic<int> sharedIndex { 2 };
 };
 
 enum Channel
 {
     Right, //effectively 0
-    Left //effectively 1
+    Left, //effectively 1
+    Downmix = -1 //the average of every channel
 };
 
+/**
+ Keeps the analyzer fifos' rings alive while the audio and analyzer threads use them, without
+ either of them ever locking. They enter it for as long as they touch a ring, and only get in
+ while it's open. Closing it waits for anyone inside to leave, so a ring can then be swapped
+ or freed. Only closing takes a lock, and closing nests, so the processor can close it around
+ both channels' prepare() and no block ever lands in one channel's new ring but not the other's.
+ */
+struct SampleFifoGuard
+{
+    // Entering never blocks: while the guard is closed, isEntered() is false and the fifos are left alone.
+    struct ScopedEntry
+    {
+        explicit ScopedEntry(SampleFifoGuard& g) noexcept : guard(g), entered(g.tryEnter()) { }
+        ~ScopedEntry() { if( entered ) guard.numUsers.fetch_sub(1); }
+        
+        bool isEntered() const noexcept { return entered; }
+    private:
+        SampleFifoGuard& guard;
+        const bool entered;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedEntry)
+    };
+    
+    // Blocks until nobody is inside. For the message thread, or wherever prepareToPlay runs.
+    struct ScopedClose
+    {
+        explicit ScopedClose(SampleFifoGuard& g) : guard(g), lock(g.closeLock)
+        {
+            if( guard.closeDepth++ == 0 )
+            {
+                guard.isOpen.store(false);
+                
+                // A copy is at most one block or one hop, so this is never a long wait.
+                while( guard.numUsers.load() != 0 )
+                    juce::Thread::yield();
+            }
+        }
+        
+        ~ScopedClose()
+        {
+            if( --guard.closeDepth == 0 )
+                guard.isOpen.store(true);
+        }
+    private:
+        SampleFifoGuard& guard;
+        const juce::ScopedLock lock;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedClose)
+    };
+private:
+    bool tryEnter() noexcept
+    {
+        // Counted in before looking (both sequentially consistent), so a closer that has seen
+        // numUsers reach zero after closing knows nobody who got in is still using a ring.
+        numUsers.fetch_add(1);
+        
+        if( isOpen.load() )
+            return true;
+        
+        numUsers.fetch_sub(1);
+        return false;
+    }
+    
+    std::atomic<bool> isOpen { true };
+    std::atomic<int> numUsers { 0 };
+    
+    juce::CriticalSection closeLock;
+    int closeDepth = 0;
+};
+
+/**
+ Captures one channel of the audio for the analyzer, in a single-producer/single-consumer ring.
+ The audio thread writes a whole block at once, which is at most two copies when the
+ ring wraps; the reader takes samples out in whatever span sizes it likes, straight
+ from the ring. If the reader falls behind, the samples that don't fit are dropped.
+ The ring is only allocated while it's needed: prepare() makes it and release() frees it.
+ Neither side locks to copy: the guard is shared with the other channel's fifo, and read()
+ enters it by itself, but update() expects its caller to have entered it once for both
+ channels, skipping the block in both if it couldn't, so the two histories never drift apart.
+ */
 template<typename BlockType>
 struct SingleChannelSampleFifo
 {
-    SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
+    SingleChannelSampleFifo(Channel ch, SampleFifoGuard& sharedGuard) : channelToUse(ch), guard(sharedGuard)
     {
         prepared.set(false);
     }
     
     void update(const BlockType& buffer)
     {
-        jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        update(buffer, channelToUse);
+    }
+    
+    /**
+     captures 'channel' from the buffer, or the average of every channel if 'channel' is Channel::Downmix.
+     The buffer may hold doubles when the host processes in double precision; the analyzer always works in float.
+     Only call this from inside the shared guard.
+     */
+    template<typename BufferType>
+    void update(const BufferType& buffer, int channel)
+    {
+        if( ! prepared.get() )
+            return;
+        
+        jassert(buffer.getNumChannels() > channel );
         
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
+        const auto numSamples = buffer.getNumSamples();
+        auto write = fifo.write(numSamples);
+        auto* ring = ringBuffer.getWritePointer(0);
+        
+        auto copySpan = [&](int ringStart, int bufferStart, int count)
         {
-            pushNextSampleIntoFifo(channelPtr[i]);
-        }
+            if( count <= 0 )
+                return;
+            
+            if( channel != Channel::Downmix )
+            {
+                auto* channelPtr = buffer.getReadPointer(channel, bufferStart);
+                
+                if constexpr ( std::is_same_v<std::decay_t<decltype(*channelPtr)>, float> )
+                {
+                    juce::FloatVectorOperations::copy(ring + ringStart, channelPtr, count);
+                }
+                else
+                {
+                    for( int i = 0; i < count; ++i )
+                        ring[ringStart + i] = (float)channelPtr[i];
+                }
+                
+                return;
+            }
+            
+            const auto numChannels = buffer.getNumChannels();
+            const auto gain = 1.f / float(juce::jmax(1, numChannels));
+            
+            for( int i = 0; i < count; ++i )
+            {
+                float sum = 0.f;
+                for( int ch = 0; ch < numChannels; ++ch )
+                    sum += (float)buffer.getSample(ch, bufferStart + i);
+                
+                ring[ringStart + i] = sum * gain;
+            }
+        };
+        
+        copySpan(write.startIndex1, 0, write.blockSize1);
+        copySpan(write.startIndex2, write.blockSize1, write.blockSize2);
     }
 
     void prepare(int bufferSize)
     {
-        prepared.set(false);
-        size.set(bufferSize);
+        // Room for well over a second of audio, so a stalled reader doesn't make it overflow straight away.
+        const auto capacity = juce::jmax(bufferSize * 30, 1 << 16);
+        
+        // Allocated before closing the guard and swapped in while it's closed, so nobody waits on an allocation.
+        BlockType newRing(1, capacity);
+        newRing.clear();
+        
+        {
+            const SampleFifoGuard::ScopedClose closed(guard);
+            
+            std::swap(ringBuffer, newRing);
+            fifo.setTotalSize(capacity);
+            fifo.reset();
+            size.set(bufferSize);
+            prepared.set(true);
+        }
+        
+        // The old ring, if there was one, is freed here, with the guard open again.
+    }
+    
+    // Frees the ring. update() and read() do nothing until the next prepare().
+    void release()
+    {
+        BlockType oldRing;
         
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
-        prepared.set(true);
+        {
+            const SampleFifoGuard::ScopedClose closed(guard);
+            
+            prepared.set(false);
+            std::swap(ringBuffer, oldRing);
+            fifo.setTotalSize(1);
+        }
     }
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
+    int getNumSamplesAvailable() const { return fifo.getNumReady(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
     //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
+    /**
+     Consumes up to numSamples, handing them to spanReader(const float* samples, int numSamples)
+     in at most two contiguous spans, straight out of the ring. Returns how many were read.
+     */
+    template<typename SpanReader>
+    int read(int numSamples, SpanReader&& spanReader)
+    {
+        // Declared first, so the read handle has given the space back before the guard is left.
+        const SampleFifoGuard::ScopedEntry entry(guard);
+        
+        if( ! entry.isEntered() || ! prepared.get() )
+            return 0;
+        
+        auto readHandle = fifo.read(numSamples);
+        auto* ring = ringBuffer.getReadPointer(0);
+        
+        if( readHandle.blockSize1 > 0 )
+            spanReader(ring + readHandle.startIndex1, readHandle.blockSize1);
+        if( readHandle.blockSize2 > 0 )
+            spanReader(ring + readHandle.startIndex2, readHandle.blockSize2);
+        
+        return readHandle.blockSize1 + readHandle.blockSize2;
+    }
 private:
     Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
+    juce::AbstractFifo fifo { 1 };
+    BlockType ringBuffer;
+    SampleFifoGuard& guard;
     juce::Atomic<bool> prepared = false;
     juce::Atomic<int> size = 0;
-    
-    void pushNextSampleIntoFifo(float sample)
-    {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
-        
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
-    }
 };
 
 enum Slope
@@ -152,6 +358,14 @@ enum Slope
     Slope_48
 };
 
+enum LinearPhaseLength
+{
+    Length_4096,
+    Length_8192,
+    Length_16384,
+    Length_32768
+};
+
 struct ChainSettings
 {
     float peakOneFreq { 0 }, peakOneGainInDecibels { 0 }, peakOneQuality { 1.f }, peakTwoFreq { 0 }, peakTwoGainInDecibels { 0 }, peakTwoQuality { 1.f }, peakThreeFreq { 0 }, peakThreeGainInDecibels { 0 }, peakThreeQuality { 1.f };
@@ -160,15 +374,28 @@ struct ChainSettings
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
     
     bool peakOneBypassed { false }, peakTwoBypassed { false }, peakThreeBypassed { false }, lowCutBypassed { false }, highCutBypassed { false};
+    
+    bool linearPhase { false };
+    LinearPhaseLength linearPhaseLength { LinearPhaseLength::Length_8192 };
+    
+    int getLinearPhaseKernelLength() const { return 4096 << linearPhaseLength; }
+    
+    // At the ends of their ranges the cuts only take out what's outside hearing, so they are left out altogether.
+    bool isLowCutActive() const { return ! lowCutBypassed && lowCutFreq > 20.f; }
+    bool isHighCutActive() const { return ! highCutBypassed && highCutFreq < 20000.f; }
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
 
-using Filter = juce::dsp::IIR::Filter<float>;
+// Everything below is templated on the sample type, so float and double hosts both get a native path.
+template<typename SampleType>
+using Filter = juce::dsp::IIR::Filter<SampleType>;
 
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+template<typename SampleType>
+using CutFilter = juce::dsp::ProcessorChain<Filter<SampleType>, Filter<SampleType>, Filter<SampleType>, Filter<SampleType>>;
 
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, Filter, Filter, CutFilter>;
+template<typename SampleType>
+using MonoChain = juce::dsp::ProcessorChain<CutFilter<SampleType>, Filter<SampleType>, Filter<SampleType>, Filter<SampleType>, CutFilter<SampleType>>;
 
 enum ChainPositions
 {
@@ -179,12 +406,84 @@ enum ChainPositions
     HighCut
 };
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+// The same type as Filter<SampleType>::CoefficientsPtr, spelled out so that SampleType can be deduced.
+template<typename SampleType>
+using Coefficients = juce::ReferenceCountedObjectPtr<juce::dsp::IIR::Coefficients<SampleType>>;
+
+template<typename SampleType>
+void updateCoefficients(Coefficients<SampleType>& old, const Coefficients<SampleType>& replacements)
+{
+    *old = *replacements;
+}
+
+/**
+ A complete, immutable set of designed coefficients for one channel's worth of filtering.
+ Only the sections that are actually active are listed, in processing order: a bypassed
+ band, or a cut stage the current slope doesn't use, simply isn't there.
+ Each biquad is stored as { b0, b1, b2, a1, a2 }, already normalised by a0,
+ which is the layout juce::dsp::IIR::Coefficients uses for a second order filter.
+ Sections are always designed in double precision and only rounded when a float path uses them,
+ which matters for very low cut-offs at high sample rates.
+ Sections that would leave the signal untouched are left out too, so they cost nothing.
+ */
+struct FilterSnapshot
+{
+    using Biquad = std::array<double, 5>;
 
-Coefficients makePeakOneFilter(const ChainSettings& chainSettings, double sampleRate);
-Coefficients makePeakTwoFilter(const ChainSettings& chainSettings, double sampleRate);
-Coefficients makePeakThreeFilter(const ChainSettings& chainSettings, double sampleRate);
+    // Four low cut stages, three peaks and four high cut stages.
+    static constexpr int MaxSections = 11;
+
+    ChainSettings settings;
+
+    int numSections = 0;
+    // Where each section sits in the full chain, so filter state can follow a section when others come and go.
+    std::array<int, MaxSections> slots {};
+    std::array<Biquad, MaxSections> sections {};
+
+    // How long the cascade keeps ringing after its input stops, worked out from its poles.
+    int tailLengthSamples = 0;
+
+    // -120 dB. The tail is measured down to this, and input that stays below it counts as silence.
+    static constexpr double silenceFloor = 1.0e-6;
+
+    void addSection(ChainPositions position, int stage, const Biquad& biquad)
+    {
+        jassert( numSections < MaxSections );
+        slots[numSections] = getSlot(position, stage);
+        sections[numSections] = biquad;
+        ++numSections;
+    }
+
+    static int getSlot(ChainPositions position, int stage)
+    {
+        switch( position )
+        {
+            case LowCut: return stage;
+            case PeakOne: return 4;
+            case PeakTwo: return 5;
+            case PeakThree: return 6;
+            case HighCut: return 7 + stage;
+        }
+
+        jassertfalse;
+        return 0;
+    }
+
+    // True when the numerator matches the denominator, e.g. a peak at 0 dB.
+    static bool isNearIdentity(const Biquad& biquad);
+    // Samples for the impulse response of all the sections in series to fall below silenceFloor.
+    int computeTailLengthSamples() const;
+};
+
+FilterSnapshot::Biquad makeBiquad(const juce::dsp::IIR::Coefficients<double>& coefficients);
+
+// Instantiated for float and double in PluginProcessor.cpp.
+template<typename SampleType>
+Coefficients<SampleType> makePeakOneFilter(const ChainSettings& chainSettings, double sampleRate);
+template<typename SampleType>
+Coefficients<SampleType> makePeakTwoFilter(const ChainSettings& chainSettings, double sampleRate);
+template<typename SampleType>
+Coefficients<SampleType> makePeakThreeFilter(const ChainSettings& chainSettings, double sampleRate);
 
 template<int Index, typename ChainType, typename CoefficientType>
 void update(ChainType& chain, const CoefficientType& coefficients)
@@ -226,23 +525,597 @@ void updateCutFilter(ChainType& cutChain,
     }
 }
 
-inline auto makeLowCutFiler(const ChainSettings &chainSettings, double sampleRate )
+template<typename SampleType>
+auto makeLowCutFiler(const ChainSettings &chainSettings, double sampleRate )
 {
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.lowCutSlope + 1));
+    return juce::dsp::FilterDesign<SampleType>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
+                                                                                            sampleRate,
+                                                                                            2 * (chainSettings.lowCutSlope + 1));
 }
 
-inline auto makeHighCutFilter(const ChainSettings &chainSettings, double sampleRate )
+template<typename SampleType>
+auto makeHighCutFilter(const ChainSettings &chainSettings, double sampleRate )
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 * (chainSettings.highCutSlope + 1));
+    return juce::dsp::FilterDesign<SampleType>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
+                                                                                           sampleRate,
+                                                                                           2 * (chainSettings.highCutSlope + 1));
 }
+
+/**
+ Butterworth cut filter designs, shared by every instance in the process.
+ The cut-off parameters move in 1 Hz steps and the slope has four choices, so each
+ design is keyed by that quantised tuple (plus the sample rate) and built the first
+ time it is asked for. After that, sweeping a knob or loading a preset is a lookup.
+ Only the design threads use this, so the lock never touches the audio thread.
+ */
+struct CutFilterCoefficientCache
+{
+    struct Design
+    {
+        int numSections = 0;
+        std::array<FilterSnapshot::Biquad, 4> sections {};
+    };
+
+    // position must be ChainPositions::LowCut or ChainPositions::HighCut.
+    Design getDesign(ChainPositions position, float frequency, Slope slope, double sampleRate);
+private:
+    // Stops a long session of sweeps at many sample rates from growing without bound.
+    static constexpr size_t maxNumDesigns = 1 << 16;
+
+    juce::CriticalSection lock;
+    std::unordered_map<juce::uint64, Design> designs;
+};
+
+/**
+ A flat cascade of second order sections, run in transposed direct form II.
+ The coefficients of every active section live side by side in one structure-of-arrays
+ block that is shared by all channels; each channel only owns its own filter state.
+ The block is filtered one whole section at a time, so the inner loop keeps a single
+ section's coefficients and state in registers.
+ SampleType may be a SIMDRegister, in which case every lane is a separate audio channel
+ and each 'channel' of the cascade is really a group of them.
+
+ New coefficients can be glided in over a number of control steps. The set of stable
+ biquad denominators is convex, so every point on a straight line between two stable
+ sections is stable too, and no redesign is needed along the way.
+ */
+template<typename SampleType>
+struct SOSCascade
+{
+    using NumericType = typename juce::dsp::SampleTypeHelpers::ElementType<SampleType>::Type;
+
+    void prepare(int numChannels)
+    {
+        states.resize((size_t)numChannels);
+        reset();
+    }
+
+    void reset()
+    {
+        for( auto& state : states )
+        {
+            state.s1.fill(SampleType{});
+            state.s2.fill(SampleType{});
+        }
+    }
+
+    /**
+     Moves to a new set of sections over numRampSteps calls to advanceRamp(), or at once if numRampSteps is 0.
+     A section that only exists on one side glides from or to a pass-through biquad,
+     and a section that was already running keeps its state.
+     */
+    void setSections(const FilterSnapshot& snapshot, int numRampSteps)
+    {
+        std::array<int, MaxSections> previousPosition, targetPosition;
+        previousPosition.fill(-1);
+        targetPosition.fill(-1);
+
+        for( int i = 0; i < numSections; ++i )
+            previousPosition[slots[i]] = i;
+
+        for( int i = 0; i < snapshot.numSections; ++i )
+            targetPosition[snapshot.slots[i]] = i;
+
+        // Slots are numbered in processing order, so walking them in order keeps the cascade in order.
+        const auto previousCoefficients = current;
+        std::array<int, MaxSections> movedFrom;
+        int n = 0;
+
+        for( int slot = 0; slot < MaxSections; ++slot )
+        {
+            const auto previous = previousPosition[slot];
+            const auto target = targetPosition[slot];
+
+            if( target < 0 && (previous < 0 || numRampSteps <= 0) )
+                continue;
+
+            slots[n] = slot;
+            inTarget[n] = target >= 0;
+            movedFrom[n] = previous;
+
+            for( int c = 0; c < 5; ++c )
+            {
+                const auto identity = NumericType(c == 0 ? 1 : 0);
+                targets[c][n] = target >= 0 ? (NumericType)snapshot.sections[target][c] : identity;
+
+                // A section that is only just appearing starts out as a pass-through, so it fades in like the rest.
+                if( numRampSteps <= 0 )
+                    current[c][n] = targets[c][n];
+                else
+                    current[c][n] = previous >= 0 ? previousCoefficients[c][previous] : identity;
+
+                increments[c][n] = (targets[c][n] - current[c][n]) / NumericType(juce::jmax(1, numRampSteps));
+            }
+
+            ++n;
+        }
+
+        for( auto& state : states )
+        {
+            const auto previousState = state;
+
+            for( int i = 0; i < n; ++i )
+            {
+                const auto previous = movedFrom[i];
+                state.s1[i] = previous >= 0 ? previousState.s1[previous] : SampleType{};
+                state.s2[i] = previous >= 0 ? previousState.s2[previous] : SampleType{};
+            }
+        }
+
+        numSections = n;
+        rampStepsRemaining = numRampSteps;
+
+        if( rampStepsRemaining <= 0 )
+            finishRamp();
+    }
+
+    bool isRamping() const { return rampStepsRemaining > 0; }
+
+    /** Takes one control-rate step along the current ramp. */
+    void advanceRamp()
+    {
+        if( rampStepsRemaining <= 0 )
+            return;
+
+        if( --rampStepsRemaining == 0 )
+        {
+            finishRamp();
+            return;
+        }
+
+        for( int c = 0; c < 5; ++c )
+            for( int k = 0; k < numSections; ++k )
+                current[c][k] += increments[c][k];
+    }
+
+    void process(int channel, SampleType* samples, int numSamples) noexcept
+    {
+        jassert( juce::isPositiveAndBelow(channel, (int)states.size()) );
+        auto& state = states[(size_t)channel];
+
+        for( int k = 0; k < numSections; ++k )
+        {
+            const auto c0 = current[0][k], c1 = current[1][k], c2 = current[2][k], d1 = current[3][k], d2 = current[4][k];
+            auto state1 = state.s1[k];
+            auto state2 = state.s2[k];
+
+            for( int i = 0; i < numSamples; ++i )
+            {
+                const auto x = samples[i];
+                const auto y = x * c0 + state1;
+                state1 = x * c1 - y * d1 + state2;
+                state2 = x * c2 - y * d2;
+                samples[i] = y;
+            }
+
+            state.s1[k] = state1;
+            state.s2[k] = state2;
+        }
+    }
+
+    int getNumSections() const { return numSections; }
+private:
+    static constexpr int MaxSections = FilterSnapshot::MaxSections;
+
+    // { b0, b1, b2, a1, a2 } for each section, the same order as FilterSnapshot::Biquad.
+    using CoefficientArrays = std::array<std::array<NumericType, MaxSections>, 5>;
+
+    struct State
+    {
+        std::array<SampleType, MaxSections> s1 {}, s2 {};
+    };
+
+    int numSections = 0;
+    int rampStepsRemaining = 0;
+    std::array<int, MaxSections> slots {};
+    std::array<bool, MaxSections> inTarget {};
+    CoefficientArrays current {}, targets {}, increments {};
+    std::vector<State> states;
+
+    // Lands exactly on the targets and drops the sections that were fading out.
+    void finishRamp()
+    {
+        int n = 0;
+
+        for( int k = 0; k < numSections; ++k )
+        {
+            if( ! inTarget[k] )
+                continue;
+
+            slots[n] = slots[k];
+            inTarget[n] = true;
+
+            for( int c = 0; c < 5; ++c )
+            {
+                current[c][n] = targets[c][k];
+                targets[c][n] = targets[c][k];
+            }
+
+            for( auto& state : states )
+            {
+                state.s1[n] = state.s1[k];
+                state.s2[n] = state.s2[k];
+            }
+
+            ++n;
+        }
+
+        numSections = n;
+        rampStepsRemaining = 0;
+    }
+};
+
+/**
+ Runs any number of channels through one SOSCascade, SIMDRegister<SampleType>::size() channels
+ at a time: each group of channels is interleaved into the register lanes, filtered in one
+ pass, and written back out. Also owns the control-rate clock that steps coefficient ramps.
+ */
+template<typename SampleType>
+struct ChannelParallelFilter
+{
+    using SIMDType = juce::dsp::SIMDRegister<SampleType>;
+    static constexpr int numLanes = (int)SIMDType::size();
+
+    // Coefficient changes glide over smoothingTimeSeconds, stepping every controlIntervalSamples
+    // whatever the host's block size, so automation is click free and costs the same at any buffer size.
+    static constexpr int controlIntervalSamples = 32;
+    static constexpr double smoothingTimeSeconds = 0.05;
+
+    void prepare(int numChannels, int maximumBlockSize, double sampleRate)
+    {
+        const auto numLaneGroups = (numChannels + numLanes - 1) / numLanes;
+        cascade.prepare(juce::jmax(1, numLaneGroups));
+
+        rampLengthInControlSteps = juce::roundToInt(smoothingTimeSeconds * sampleRate / controlIntervalSamples);
+        samplesUntilControlTick = controlIntervalSamples;
+        // There is nothing sensible to glide from after a prepare, so the first snapshot lands immediately.
+        snapToNextSnapshot = true;
+
+        interleaved.assign((size_t)juce::jmax(1, maximumBlockSize), SIMDType::expand(SampleType(0)));
+
+        silentSamples = 0;
+        idle = false;
+    }
+
+    void applySnapshot(const FilterSnapshot& snapshot)
+    {
+        // While idle there is no sound to glide under, so changes land at once.
+        const auto snap = snapToNextSnapshot || idle;
+        cascade.setSections(snapshot, snap ? 0 : rampLengthInControlSteps);
+        snapToNextSnapshot = false;
+        samplesUntilControlTick = controlIntervalSamples;
+
+        // Until the input goes quiet for long enough, the outgoing sections may still be ringing.
+        targetTailLengthSamples = snapshot.tailLengthSamples;
+        tailLengthSamples = snap ? targetTailLengthSamples
+                                 : juce::jmax(tailLengthSamples, targetTailLengthSamples) + rampLengthInControlSteps * controlIntervalSamples;
+    }
+
+    void process(juce::dsp::AudioBlock<SampleType>& block)
+    {
+        const auto numChannels = (int)block.getNumChannels();
+        const auto numSamples = (int)block.getNumSamples();
+        const auto maxChunkSize = (int)interleaved.size();
+
+        // Only the filter for the current processing precision is prepared; an unprepared one has nowhere to work.
+        jassert( maxChunkSize > 0 );
+        if( maxChunkSize == 0 )
+            return;
+
+        // Every section is a pass-through, so there is nothing to do.
+        if( cascade.getNumSections() == 0 )
+            return;
+
+        if( canSkip(block) )
+            return;
+
+        auto* lanes = reinterpret_cast<SampleType*>(interleaved.data());
+
+        for( int start = 0; start < numSamples; )
+        {
+            // Hosts may occasionally send more samples than prepareToPlay promised,
+            // so work through the block in segments that fit the interleaved buffer.
+            auto segmentSize = juce::jmin(maxChunkSize, numSamples - start);
+
+            // While a ramp is running the coefficients only move on control ticks, so segments end there.
+            if( cascade.isRamping() )
+                segmentSize = juce::jmin(segmentSize, samplesUntilControlTick);
+
+            for( int firstChannel = 0, group = 0; firstChannel < numChannels; firstChannel += numLanes, ++group )
+            {
+                const auto numChannelsInGroup = juce::jmin(numLanes, numChannels - firstChannel);
+
+                for( int lane = 0; lane < numLanes; ++lane )
+                {
+                    if( lane < numChannelsInGroup )
+                    {
+                        auto* channel = block.getChannelPointer((size_t)(firstChannel + lane)) + start;
+
+                        for( int i = 0; i < segmentSize; ++i )
+                            lanes[i * numLanes + lane] = channel[i];
+                    }
+                    else
+                    {
+                        // Keep lanes with no channel behind them silent.
+                        for( int i = 0; i < segmentSize; ++i )
+                            lanes[i * numLanes + lane] = SampleType(0);
+                    }
+                }
+
+                cascade.process(group, interleaved.data(), segmentSize);
+
+                for( int lane = 0; lane < numChannelsInGroup; ++lane )
+                {
+                    auto* channel = block.getChannelPointer((size_t)(firstChannel + lane)) + start;
+
+                    for( int i = 0; i < segmentSize; ++i )
+                        channel[i] = lanes[i * numLanes + lane];
+                }
+            }
+
+            if( cascade.isRamping() )
+            {
+                samplesUntilControlTick -= segmentSize;
+
+                if( samplesUntilControlTick == 0 )
+                {
+                    cascade.advanceRamp();
+                    samplesUntilControlTick = controlIntervalSamples;
+                }
+            }
+
+            start += segmentSize;
+        }
+    }
+private:
+    SOSCascade<SIMDType> cascade;
+    std::vector<SIMDType> interleaved;
+
+    int rampLengthInControlSteps = 0;
+    int samplesUntilControlTick = controlIntervalSamples;
+    bool snapToNextSnapshot = true;
+
+    // The same floor the snapshot's tail length is measured to.
+    static constexpr SampleType silenceThreshold = SampleType(FilterSnapshot::silenceFloor);
+
+    int tailLengthSamples = 0, targetTailLengthSamples = 0;
+    juce::int64 silentSamples = 0;
+    bool idle = false;
+
+    /**
+     Once the input has been silent for longer than the tail, the output is silent too,
+     so filtering can stop until sound comes back. The state is cleared on the way in,
+     since whatever is left in it has already decayed below the threshold.
+     */
+    bool canSkip(const juce::dsp::AudioBlock<SampleType>& block)
+    {
+        const auto range = block.findMinAndMax();
+        const auto isSilent = juce::jmax(std::abs(range.getStart()), std::abs(range.getEnd())) <= silenceThreshold;
+
+        if( ! isSilent )
+        {
+            silentSamples = 0;
+            idle = false;
+            return false;
+        }
+
+        if( idle )
+            return true;
+
+        silentSamples += (juce::int64)block.getNumSamples();
+
+        if( cascade.isRamping() || silentSamples <= tailLengthSamples )
+            return false;
+
+        cascade.reset();
+        tailLengthSamples = targetTailLengthSamples;
+        idle = true;
+        return true;
+    }
+};
+
+/**
+ The linear-phase version of the whole chain, for mastering.
+ A FIR kernel with the same magnitude response as a FilterSnapshot is designed on the
+ design thread and run through juce::dsp::Convolution, which uses uniformly partitioned
+ FFT convolution, builds each new engine on its own background thread, and crossfades
+ from the old kernel to the new one without allocating on the audio thread.
+ Convolution handles at most two channels, so each pair of channels gets its own instance.
+ Every instance in the process shares one message queue, and so one loading thread, and the
+ engines are only built the first time a kernel is loaded, so an instance that never uses
+ linear phase costs nothing for it. The kernel is symmetric about its centre, which delays
+ everything by half its length.
+ */
+struct LinearPhaseFilter
+{
+    // Drops any engines, which are rebuilt for the new spec by the next loadKernel().
+    void prepare(int numChannels, int maximumBlockSize, double sampleRate);
+
+    // Designs the kernel and hands it to every channel pair, building the engines first if need be.
+    // Call from the design thread only, or from prepareToPlay.
+    void loadKernel(const FilterSnapshot& snapshot, int kernelLength, double sampleRate);
+
+    // Clears the convolution history, which goes stale while the IIR path is in use. Audio thread only.
+    void reset();
+
+    // Convolution only runs in float, so double blocks go through a float scratch buffer.
+    void process(juce::dsp::AudioBlock<float>& block);
+    void process(juce::dsp::AudioBlock<double>& block);
+
+    static int getLatencySamples(int kernelLength) { return kernelLength / 2; }
+    // True once the audio thread is running a kernel of this length, designed at this sample rate. Call from the audio thread only.
+    bool isKernelLoaded(int kernelLength, double sampleRate);
+private:
+    static constexpr int maxNumPairs = 8;
+
+    juce::SharedResourcePointer<juce::dsp::ConvolutionMessageQueue> messageQueue;
+    std::array<std::unique_ptr<juce::dsp::Convolution>, maxNumPairs> convolutions;
+    // Zero until the engines are built. The audio thread only touches the engines below this.
+    std::atomic<int> numActivePairs { 0 };
+    int numPairsNeeded = 0;
+    int maximumBlockSize = 0;
+
+    // The engines are built empty after every prepare, and only ever given kernels designed for this rate.
+    double preparedSampleRate = 0.0;
+
+    juce::AudioBuffer<float> floatScratch;
+
+    // Design-time scratch, only touched by loadKernel.
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> spectrum, window;
+
+    // The response and length of the kernel the engines were last given, so a redesign that
+    // doesn't change them (moving a bypassed band's knob, say) doesn't rebuild it.
+    int loadedKernelLength = 0;
+    int loadedNumSections = 0;
+    std::array<FilterSnapshot::Biquad, FilterSnapshot::MaxSections> loadedSections {};
+
+    bool isLoaded(const FilterSnapshot& snapshot, int kernelLength) const;
+};
+
+/**
+ What processBlock costs, kept in lock-free counters so the editor, a benchmark or a
+ headless render can read them while audio runs. The audio thread is the only writer of
+ the block figures, so plain relaxed loads and stores are enough and there are no
+ read-modify-write instructions on that path; timing a block costs two tick reads.
+ */
+struct ProcessLoadStats
+{
+    // Buckets of real-time budget used: 0-10%, 10-20%, ..., 90-100%, and over budget.
+    static constexpr int numHistogramBuckets = 11;
+
+    struct Values
+    {
+        double lastBlockMicroseconds = 0.0, lastBudgetPercent = 0.0;
+        double worstBlockMicroseconds = 0.0, worstBudgetPercent = 0.0;
+        std::array<juce::int64, numHistogramBuckets> histogram {};
+        juce::int64 numBlocks = 0, numRedesigns = 0;
+    };
+
+    void prepare(double sampleRate)
+    {
+        budgetTicksPerSample.store((double)juce::Time::getHighResolutionTicksPerSecond() / sampleRate, std::memory_order_relaxed);
+        reset();
+    }
+
+    void reset()
+    {
+        lastTicks.store(0, std::memory_order_relaxed);
+        lastNumSamples.store(0, std::memory_order_relaxed);
+        worstTicks.store(0, std::memory_order_relaxed);
+        worstBudgetFraction.store(0.0, std::memory_order_relaxed);
+        numBlocks.store(0, std::memory_order_relaxed);
+
+        for( auto& bucket : histogram )
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    // Audio thread only.
+    void recordBlock(juce::int64 elapsedTicks, int numSamples) noexcept
+    {
+        const auto ticksPerSample = budgetTicksPerSample.load(std::memory_order_relaxed);
+
+        if( numSamples <= 0 || ticksPerSample <= 0.0 )
+            return;
+
+        const auto budgetFraction = (double)elapsedTicks / (ticksPerSample * numSamples);
+
+        lastTicks.store(elapsedTicks, std::memory_order_relaxed);
+        lastNumSamples.store(numSamples, std::memory_order_relaxed);
+
+        if( elapsedTicks > worstTicks.load(std::memory_order_relaxed) )
+            worstTicks.store(elapsedTicks, std::memory_order_relaxed);
+
+        if( budgetFraction > worstBudgetFraction.load(std::memory_order_relaxed) )
+            worstBudgetFraction.store(budgetFraction, std::memory_order_relaxed);
+
+        auto& bucket = histogram[(size_t)juce::jlimit(0, numHistogramBuckets - 1, (int)(budgetFraction * 10.0))];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        numBlocks.store(numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Called from whichever thread designs the filters.
+    void recordRedesign() noexcept { numRedesigns.fetch_add(1, std::memory_order_relaxed); }
+
+    // Safe from any thread. The figures are read one at a time, so they may straddle a block.
+    Values getValues() const
+    {
+        Values values;
+        const auto ticksPerMicrosecond = (double)juce::Time::getHighResolutionTicksPerSecond() * 1.0e-6;
+        const auto ticks = lastTicks.load(std::memory_order_relaxed);
+        const auto numSamples = lastNumSamples.load(std::memory_order_relaxed);
+        const auto ticksPerSample = budgetTicksPerSample.load(std::memory_order_relaxed);
+
+        values.lastBlockMicroseconds = ticks / ticksPerMicrosecond;
+        values.lastBudgetPercent = numSamples > 0 && ticksPerSample > 0.0 ? 100.0 * ticks / (ticksPerSample * numSamples) : 0.0;
+        values.worstBlockMicroseconds = worstTicks.load(std::memory_order_relaxed) / ticksPerMicrosecond;
+        values.worstBudgetPercent = 100.0 * worstBudgetFraction.load(std::memory_order_relaxed);
+
+        for( size_t i = 0; i < histogram.size(); ++i )
+            values.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+
+        values.numBlocks = numBlocks.load(std::memory_order_relaxed);
+        values.numRedesigns = numRedesigns.load(std::memory_order_relaxed);
+        return values;
+    }
+private:
+    // Written by prepareToPlay while the editor may be reading.
+    std::atomic<double> budgetTicksPerSample { 0.0 };
+
+    std::atomic<juce::int64> lastTicks { 0 }, worstTicks { 0 }, numBlocks { 0 }, numRedesigns { 0 };
+    std::atomic<int> lastNumSamples { 0 };
+    // The worst fraction is tracked separately, since the longest block isn't always the biggest share of its budget.
+    std::atomic<double> worstBudgetFraction { 0.0 };
+    std::array<std::atomic<juce::int64>, numHistogramBuckets> histogram {};
+};
+
+class SimpleEQAudioProcessor;
+
+/**
+ One background thread shared by every SimpleEQAudioProcessor in the process.
+ It polls the registered processors and redesigns their filters whenever a
+ parameter has changed, so that work never lands on the audio thread.
+ */
+struct FilterDesignThread : juce::Thread
+{
+    FilterDesignThread();
+    ~FilterDesignThread() override;
+
+    void addProcessor(SimpleEQAudioProcessor* processor);
+    void removeProcessor(SimpleEQAudioProcessor* processor);
+
+    void run() override;
+private:
+    juce::CriticalSection lock;
+    juce::Array<SimpleEQAudioProcessor*> processors;
+};
+
 //==============================================================================
 /**
 */
-class SimpleEQAudioProcessor  : public juce::AudioProcessor
+class SimpleEQAudioProcessor  : public juce::AudioProcessor,
+                                private juce::AudioProcessorParameter::Listener,
+                                private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -258,6 +1131,8 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -286,18 +1161,91 @@ public:
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
     
     using BlockType = juce::AudioBuffer<float>;
-    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
-    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    // Shared by the two fifos, so the audio thread keeps or drops each block in both channels together.
+    SampleFifoGuard analyzerFifoGuard;
+    SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left, analyzerFifoGuard };
+    SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right, analyzerFifoGuard };
+    
+    // 7.1.4 needs 12 channels and third order ambisonics needs 16.
+    static constexpr int maxNumChannels = 16;
+
+    // Called by the FilterDesignThread. Redesigns the filters if any parameter changed since the last call.
+    void updateFiltersIfNeeded();
+
+    // True while a parameter change is still waiting for, or going through, a redesign.
+    // For offline tools that need the filters to settle before they start.
+    bool isFilterUpdatePending();
+
+    // For offline rendering: true until the linear-phase kernel for the current settings has reached
+    // the audio thread, which takes some processBlock calls. Call from the thread that runs processBlock.
+    bool isLinearPhaseKernelPending();
+
+    // The latency of the most recently designed filters. The host only hears about it from the message thread,
+    // so an offline render that doesn't run one should read this rather than getLatencySamples().
+    int getDesignedLatencySamples() const { return pendingLatencySamples.load(); }
+
+    const ProcessLoadStats& getLoadStats() const { return loadStats; }
     
+    /**
+     The analyzer fifos only take memory, and the audio thread only feeds them, while something
+     holds them; the editor does for as long as it's open. Call from the message thread.
+     */
+    void acquireAnalyzerCapture();
+    void releaseAnalyzerCapture();
+
 private:
+
+    // Only the one matching getProcessingPrecision() is prepared, and it is the only one processBlock uses.
+    ChannelParallelFilter<float> floatFilter;
+    ChannelParallelFilter<double> doubleFilter;
     
-    MonoChain leftChain, rightChain;
+    // Used instead of the filters above while the "Linear Phase" parameter is on.
+    LinearPhaseFilter linearPhaseFilter;
+    // Whether the last block went through linearPhaseFilter. Audio thread only.
+    bool linearPhaseActive = false;
     
-    void updatePeakFilters(const ChainSettings& chainSettings);
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilters(const ChainSettings& chainSettings);
-    void updateFilters();
+    template<typename SampleType>
+    ChannelParallelFilter<SampleType>& getChannelParallelFilter();
     
+    template<typename SampleType>
+    void processBlockInternal(juce::AudioBuffer<SampleType>& buffer);
+    
+    // Which channel feeds each analyzer fifo. Cached so the audio thread never looks a parameter up by name.
+    std::atomic<float>* analyzerLeftSource = nullptr;
+    std::atomic<float>* analyzerRightSource = nullptr;
+    std::atomic<float>* analyzerEnabled = nullptr;
+    int getAnalyzerChannel(const std::atomic<float>* sourceParameter, int numChannels) const;
+    
+    // Guards the fifos' allocation, which prepareToPlay may do off the message thread.
+    juce::CriticalSection analyzerCaptureLock;
+    int numAnalyzerCaptureHolders = 0;
+    int analyzerBlockSize = 0;
+
+    void parameterValueChanged (int parameterIndex, float newValue) override;
+    void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override { }
+    
+    // Indexed by parameter index; false for the analyzer's parameters. Filled in the constructor and only read after.
+    std::vector<bool> affectsFilters;
+    
+    // The design thread works out the latency and tail, and this passes them on to the host from the message thread.
+    void handleAsyncUpdate() override;
+    std::atomic<int> pendingLatencySamples { 0 };
+    std::atomic<bool> tailLengthChanged { false };
+
+    // Designs every stage into the next snapshot and publishes it. Never called on the audio thread.
+    void updateFilters();
+    void designPeakFilters(const ChainSettings& chainSettings, FilterSnapshot& snapshot);
+    void designLowCutFilters(const ChainSettings& chainSettings, FilterSnapshot& snapshot);
+    void designHighCutFilters(const ChainSettings& chainSettings, FilterSnapshot& snapshot);
+
+    juce::Atomic<bool> parametersChanged { false };
+    juce::CriticalSection designLock;
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    ProcessLoadStats loadStats;
+    TripleBuffer<FilterSnapshot> filterSnapshots;
+    juce::SharedResourcePointer<FilterDesignThread> filterDesignThread;
+    juce::SharedResourcePointer<CutFilterCoefficientCache> cutFilterCoefficientCache;
+
     juce::dsp::Oscillator<float> osc;
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleEQAudioProcessor)
@@ -0,0 +1,354 @@
+/*
+  ==============================================================================
+
+    Headless batch renderer: runs audio files through SimpleEQAudioProcessor
+    with a given preset and writes the results, one processor per worker thread.
+
+    Usage:
+      BatchRender --preset=<file> --output=<dir> [--threads=N] [--block-size=N]
+                  [--with-tail] <file or directory>...
+
+    Files found inside a directory argument keep their path relative to it,
+    so the output directory mirrors the input tree.
+
+    The preset is either the binary state the plugin saves, or that state as XML.
+    Inputs can be WAV, AIFF or FLAC; each output keeps its input's format,
+    sample rate, channel count and bit depth where the format allows.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#include <iostream>
+
+namespace
+{
+struct RenderSettings
+{
+    juce::MemoryBlock state;
+    juce::File outputDirectory;
+    int blockSize = 512;
+    bool withTail = false;
+};
+
+// One input file and where its rendered copy goes.
+struct RenderJob
+{
+    juce::File input, output;
+};
+
+juce::CriticalSection logLock;
+
+void log(const juce::String& message)
+{
+    const juce::ScopedLock sl(logLock);
+    std::cout << message << std::endl;
+}
+
+bool loadPreset(const juce::File& file, juce::MemoryBlock& state)
+{
+    if ( ! file.loadFileAsData(state) )
+        return false;
+
+    // XML presets are turned into the binary form that getStateInformation() writes.
+    if ( auto xml = juce::parseXML(file) )
+    {
+        auto tree = juce::ValueTree::fromXml(*xml);
+
+        if ( ! tree.isValid() )
+            return false;
+
+        state.reset();
+        juce::MemoryOutputStream mos(state, false);
+        tree.writeToStream(mos);
+    }
+
+    return state.getSize() > 0;
+}
+
+/**
+ Owns one processor and renders files from the shared queue until it is empty.
+ Audio is streamed in blockSize chunks, so memory use doesn't depend on file length.
+ */
+struct RenderWorker : juce::Thread
+{
+    RenderWorker(const RenderSettings& s, const juce::Array<RenderJob>& j, std::atomic<int>& next, std::atomic<int>& failed) :
+    juce::Thread("BatchRender worker"),
+    settings(s),
+    jobs(j),
+    nextFile(next),
+    numFailed(failed)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    ~RenderWorker() override
+    {
+        stopThread(-1);
+    }
+
+    void run() override
+    {
+        for ( auto index = nextFile++; index < jobs.size() && ! threadShouldExit(); index = nextFile++ )
+        {
+            const auto& job = jobs.getReference(index);
+            juce::String error;
+
+            if ( render(job.input, job.output, error) )
+            {
+                log("Rendered " + job.input.getFullPathName());
+            }
+            else
+            {
+                log("Failed " + job.input.getFullPathName() + ": " + error);
+                ++numFailed;
+            }
+        }
+    }
+
+    // Created on the main thread, so the message manager exists when the parameters are built.
+    SimpleEQAudioProcessor processor;
+private:
+    const RenderSettings& settings;
+    const juce::Array<RenderJob>& jobs;
+    std::atomic<int>& nextFile;
+    std::atomic<int>& numFailed;
+    juce::AudioFormatManager formatManager;
+
+    bool render(const juce::File& input, const juce::File& output, juce::String& error)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+
+        if ( reader == nullptr )
+        {
+            error = "unreadable or unsupported format";
+            return false;
+        }
+
+        const auto numChannels = (int)reader->numChannels;
+        const auto sampleRate = reader->sampleRate;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(numChannels));
+
+        if ( ! processor.setBusesLayout(layout) )
+        {
+            error = juce::String(numChannels) + " channels isn't a supported layout";
+            return false;
+        }
+
+        // prepareToPlay designs the filters for the state that was just loaded, before any audio goes through.
+        // It designs against getSampleRate(), which a host would have set by now.
+        processor.setStateInformation(settings.state.getData(), (int)settings.state.getSize());
+        processor.setNonRealtime(true);
+        processor.setRateAndBufferSizeDetails(sampleRate, settings.blockSize);
+        processor.prepareToPlay(sampleRate, settings.blockSize);
+
+        juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        // A linear-phase kernel is built in the background; run silence through until it's in place.
+        while ( processor.isLinearPhaseKernelPending() && ! threadShouldExit() )
+        {
+            buffer.clear();
+            processor.processBlock(buffer, midi);
+            juce::Thread::sleep(1);
+        }
+
+        auto* format = formatManager.findFormatForFileExtension(input.getFileExtension());
+        jassert( format != nullptr );
+
+        auto bitDepth = (int)reader->bitsPerSample;
+        if ( ! format->getPossibleBitDepths().contains(bitDepth) )
+            bitDepth = 24;
+
+        if ( ! output.getParentDirectory().createDirectory() )
+        {
+            error = "couldn't create " + output.getParentDirectory().getFullPathName();
+            return false;
+        }
+
+        // main() has already made sure this is never one of the inputs.
+        output.deleteFile();
+
+        auto stream = std::make_unique<juce::FileOutputStream>(output);
+        if ( stream->failedToOpen() )
+        {
+            error = "couldn't open " + output.getFullPathName();
+            return false;
+        }
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sampleRate, (unsigned int)numChannels, bitDepth, {}, 0));
+
+        if ( writer == nullptr )
+        {
+            error = "couldn't create a writer for " + output.getFullPathName();
+            return false;
+        }
+
+        // The writer owns the stream now.
+        stream.release();
+
+        // Skip the plugin's latency at the start, and keep going that far past the end, so the output lines up with the input.
+        // Nothing pumps the message thread here, so the host-facing getLatencySamples() can lag the filters being run.
+        auto samplesToSkip = (juce::int64)processor.getDesignedLatencySamples();
+        auto samplesToWrite = reader->lengthInSamples;
+
+        if ( settings.withTail )
+            samplesToWrite += (juce::int64)std::ceil(processor.getTailLengthSeconds() * sampleRate);
+
+        for ( juce::int64 readPosition = 0; samplesToWrite > 0 && ! threadShouldExit(); )
+        {
+            // Past the end of the file the reader fills in silence.
+            reader->read(&buffer, 0, settings.blockSize, readPosition, true, true);
+            processor.processBlock(buffer, midi);
+            readPosition += settings.blockSize;
+
+            const auto skip = (int)juce::jmin(samplesToSkip, (juce::int64)settings.blockSize);
+            samplesToSkip -= skip;
+
+            const auto numToWrite = (int)juce::jmin(samplesToWrite, (juce::int64)(settings.blockSize - skip));
+
+            if ( numToWrite > 0 && ! writer->writeFromAudioSampleBuffer(buffer, skip, numToWrite) )
+            {
+                error = "write failed";
+                return false;
+            }
+
+            samplesToWrite -= numToWrite;
+        }
+
+        processor.releaseResources();
+        return samplesToWrite == 0;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RenderWorker)
+};
+
+// Queues a file, or every audio file under a directory, with each output at the same path relative to outputDirectory.
+void addJobs(const juce::File& root, const juce::File& outputDirectory, const juce::AudioFormatManager& formatManager, juce::Array<RenderJob>& jobs)
+{
+    auto addJob = [&](const juce::File& input, const juce::String& relativePath)
+    {
+        RenderJob job { input, outputDirectory.getChildFile(relativePath) };
+
+        // The same file named twice, e.g. on its own and inside a directory, is only rendered once.
+        for ( const auto& existing : jobs )
+            if ( existing.input == job.input && existing.output == job.output )
+                return;
+
+        jobs.add(job);
+    };
+
+    if ( root.isDirectory() )
+    {
+        for ( const auto& entry : juce::RangedDirectoryIterator(root, true, formatManager.getWildcardForAllFormats()) )
+            addJob(entry.getFile(), entry.getFile().getRelativePathFrom(root));
+    }
+    else if ( root.existsAsFile() )
+    {
+        addJob(root, root.getFileName());
+    }
+}
+
+// Returns an error if a render would overwrite an input, or two renders would write the same file.
+juce::String findOutputClash(const juce::Array<RenderJob>& jobs)
+{
+    for ( int i = 0; i < jobs.size(); ++i )
+    {
+        const auto& output = jobs.getReference(i).output;
+
+        for ( int j = 0; j < jobs.size(); ++j )
+        {
+            const auto& other = jobs.getReference(j);
+
+            if ( output == other.input )
+                return output.getFullPathName() + " is an input and would be overwritten";
+
+            if ( j > i && output == other.output )
+                return jobs.getReference(i).input.getFullPathName() + " and " + other.input.getFullPathName()
+                     + " would both be written to " + output.getFullPathName();
+        }
+    }
+
+    return {};
+}
+
+int printUsage()
+{
+    std::cerr << "Usage: BatchRender --preset=<file> --output=<dir> [--threads=N] [--block-size=N] [--with-tail] <file or directory>..." << std::endl;
+    return 1;
+}
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    RenderSettings settings;
+
+    if ( ! args.containsOption("--preset") || ! args.containsOption("--output") )
+        return printUsage();
+
+    auto presetFile = args.getFileForOption("--preset");
+    if ( ! loadPreset(presetFile, settings.state) )
+    {
+        std::cerr << "Couldn't load a preset from " << presetFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    settings.outputDirectory = args.getFileForOption("--output");
+    if ( ! settings.outputDirectory.createDirectory() )
+    {
+        std::cerr << "Couldn't create " << settings.outputDirectory.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    if ( args.containsOption("--block-size") )
+        settings.blockSize = juce::jlimit(32, 65536, args.getValueForOption("--block-size").getIntValue());
+
+    settings.withTail = args.containsOption("--with-tail");
+
+    auto numThreads = juce::SystemStats::getNumCpus();
+    if ( args.containsOption("--threads") )
+        numThreads = juce::jmax(1, args.getValueForOption("--threads").getIntValue());
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::Array<RenderJob> jobs;
+    for ( const auto& arg : args.arguments )
+    {
+        if ( ! arg.isOption() )
+            addJobs(arg.resolveAsFile(), settings.outputDirectory, formatManager, jobs);
+    }
+
+    if ( jobs.isEmpty() )
+        return printUsage();
+
+    if ( auto clash = findOutputClash(jobs); clash.isNotEmpty() )
+    {
+        std::cerr << "Refusing to render: " << clash << std::endl;
+        return 1;
+    }
+
+    std::atomic<int> nextFile { 0 }, numFailed { 0 };
+    juce::OwnedArray<RenderWorker> workers;
+
+    for ( int i = 0; i < juce::jmin(numThreads, jobs.size()); ++i )
+        workers.add(new RenderWorker(settings, jobs, nextFile, numFailed));
+
+    for ( auto* worker : workers )
+        worker->startThread();
+
+    for ( auto* worker : workers )
+        worker->waitForThreadToExit(-1);
+
+    log(juce::String(jobs.size() - numFailed.load()) + " of " + juce::String(jobs.size()) + " files rendered");
+
+    return numFailed.load() == 0 ? 0 : 1;
+}
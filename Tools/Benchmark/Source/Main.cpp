@@ -0,0 +1,315 @@
+/*
+  ==============================================================================
+
+    Micro-benchmarks for SimpleEQAudioProcessor::processBlock and for a
+    stereo pair of MonoChains, the per-channel chain the editor still uses.
+
+    Usage:
+      Benchmark [--full] [--seconds=S] [--output=<file.json>]
+
+    By default three sweeps run: block size against sample rate, low cut slope
+    against high cut slope, and all 32 combinations of the bypass switches.
+    --full runs the whole cartesian product instead, which takes a while.
+    Results are written as JSON, to stdout unless --output is given.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+
+#include <iostream>
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace
+{
+constexpr int numChannels = 2;
+
+const std::array<int, 9> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+const std::array<double, 6> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+
+const std::array<const char*, 5> bypassParameters { "LowCut Bypassed", "PeakOne Bypassed", "PeakTwo Bypassed", "PeakThree Bypassed", "HighCut Bypassed" };
+
+struct BenchmarkCase
+{
+    int blockSize = 512;
+    double sampleRate = 48000.0;
+    Slope lowCutSlope = Slope::Slope_12, highCutSlope = Slope::Slope_12;
+    // Bit n set means bypassParameters[n] is on.
+    int bypassMask = 0;
+};
+
+struct Measurement
+{
+    double seconds = 0.0;
+    juce::int64 cycles = 0;
+    juce::int64 numSamples = 0;
+};
+
+juce::int64 readCycleCounter()
+{
+   #if JUCE_INTEL
+    return (juce::int64)__rdtsc();
+   #else
+    return 0;
+   #endif
+}
+
+void setParameter(SimpleEQAudioProcessor& processor, const juce::String& parameterID, float value)
+{
+    auto* parameter = processor.apvts.getParameter(parameterID);
+    jassert( parameter != nullptr );
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+/**
+ Runs processFunction on blockSize chunks of a noise buffer, first to warm up,
+ then for at least the given amount of audio. Noise rather than silence,
+ since the processor stops filtering once its input has been silent for a while.
+ */
+template<typename ProcessFunction>
+Measurement measure(juce::AudioBuffer<float>& source, int blockSize, double sampleRate, double secondsOfAudio, ProcessFunction&& processFunction)
+{
+    juce::AudioBuffer<float> block(numChannels, blockSize);
+    const auto numBlocks = juce::jmax(1, juce::roundToInt(secondsOfAudio * sampleRate / blockSize));
+    const auto numSourceBlocks = source.getNumSamples() / blockSize;
+
+    auto runBlocks = [&](int count)
+    {
+        for ( int i = 0; i < count; ++i )
+        {
+            const auto offset = (i % numSourceBlocks) * blockSize;
+
+            for ( int ch = 0; ch < numChannels; ++ch )
+                block.copyFrom(ch, 0, source, ch, offset, blockSize);
+
+            processFunction(block);
+        }
+    };
+
+    runBlocks(juce::jmax(1, numBlocks / 10));
+
+    Measurement result;
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    const auto startCycles = readCycleCounter();
+
+    runBlocks(numBlocks);
+
+    result.cycles = readCycleCounter() - startCycles;
+    result.seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    result.numSamples = (juce::int64)numBlocks * blockSize;
+
+    return result;
+}
+
+Measurement measureProcessor(const BenchmarkCase& benchmarkCase, juce::AudioBuffer<float>& source, double secondsOfAudio)
+{
+    SimpleEQAudioProcessor processor;
+
+    // The filters are designed against getSampleRate(), which a host sets before preparing.
+    processor.setNonRealtime(true);
+    processor.setRateAndBufferSizeDetails(benchmarkCase.sampleRate, benchmarkCase.blockSize);
+    processor.prepareToPlay(benchmarkCase.sampleRate, benchmarkCase.blockSize);
+
+    // Some filters in every stage, so nothing gets left out of the chain for being a pass-through.
+    setParameter(processor, "LowCut Freq", 40.f);
+    setParameter(processor, "HighCut Freq", 16000.f);
+    setParameter(processor, "PeakOne Gain", 3.f);
+    setParameter(processor, "PeakTwo Gain", -3.f);
+    setParameter(processor, "PeakThree Gain", 3.f);
+    setParameter(processor, "LowCut Slope", (float)benchmarkCase.lowCutSlope);
+    setParameter(processor, "HighCut Slope", (float)benchmarkCase.highCutSlope);
+
+    for ( size_t i = 0; i < bypassParameters.size(); ++i )
+        setParameter(processor, bypassParameters[i], (benchmarkCase.bypassMask >> i) & 1 ? 1.f : 0.f);
+
+    // Let the design thread pick all of that up before timing, so no new snapshot (and no coefficient
+    // ramp) can arrive mid-run. The first block after prepareToPlay lands the latest snapshot at once.
+    while ( processor.isFilterUpdatePending() )
+        juce::Thread::sleep(1);
+
+    juce::MidiBuffer midi;
+    return measure(source, benchmarkCase.blockSize, benchmarkCase.sampleRate, secondsOfAudio, [&](juce::AudioBuffer<float>& block)
+    {
+        processor.processBlock(block, midi);
+    });
+}
+
+Measurement measureMonoChain(const BenchmarkCase& benchmarkCase, juce::AudioBuffer<float>& source, double secondsOfAudio)
+{
+    ChainSettings chainSettings;
+    chainSettings.lowCutFreq = 40.f;
+    chainSettings.highCutFreq = 16000.f;
+    chainSettings.peakOneFreq = 500.f;
+    chainSettings.peakOneGainInDecibels = 3.f;
+    chainSettings.peakTwoFreq = 2000.f;
+    chainSettings.peakTwoGainInDecibels = -3.f;
+    chainSettings.peakThreeFreq = 6000.f;
+    chainSettings.peakThreeGainInDecibels = 3.f;
+    chainSettings.lowCutSlope = benchmarkCase.lowCutSlope;
+    chainSettings.highCutSlope = benchmarkCase.highCutSlope;
+
+    juce::dsp::ProcessSpec spec;
+    spec.maximumBlockSize = (juce::uint32)benchmarkCase.blockSize;
+    spec.numChannels = 1;
+    spec.sampleRate = benchmarkCase.sampleRate;
+
+    std::array<MonoChain<float>, numChannels> chains;
+
+    for ( auto& chain : chains )
+    {
+        chain.prepare(spec);
+
+        updateCutFilter(chain.get<ChainPositions::LowCut>(), makeLowCutFiler<float>(chainSettings, spec.sampleRate), chainSettings.lowCutSlope);
+        updateCoefficients(chain.get<ChainPositions::PeakOne>().coefficients, makePeakOneFilter<float>(chainSettings, spec.sampleRate));
+        updateCoefficients(chain.get<ChainPositions::PeakTwo>().coefficients, makePeakTwoFilter<float>(chainSettings, spec.sampleRate));
+        updateCoefficients(chain.get<ChainPositions::PeakThree>().coefficients, makePeakThreeFilter<float>(chainSettings, spec.sampleRate));
+        updateCutFilter(chain.get<ChainPositions::HighCut>(), makeHighCutFilter<float>(chainSettings, spec.sampleRate), chainSettings.highCutSlope);
+
+        chain.setBypassed<ChainPositions::LowCut>((benchmarkCase.bypassMask >> 0) & 1);
+        chain.setBypassed<ChainPositions::PeakOne>((benchmarkCase.bypassMask >> 1) & 1);
+        chain.setBypassed<ChainPositions::PeakTwo>((benchmarkCase.bypassMask >> 2) & 1);
+        chain.setBypassed<ChainPositions::PeakThree>((benchmarkCase.bypassMask >> 3) & 1);
+        chain.setBypassed<ChainPositions::HighCut>((benchmarkCase.bypassMask >> 4) & 1);
+    }
+
+    return measure(source, benchmarkCase.blockSize, benchmarkCase.sampleRate, secondsOfAudio, [&](juce::AudioBuffer<float>& block)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        juce::dsp::AudioBlock<float> audioBlock(block);
+
+        for ( int ch = 0; ch < numChannels; ++ch )
+        {
+            auto channelBlock = audioBlock.getSingleChannelBlock((size_t)ch);
+            juce::dsp::ProcessContextReplacing<float> context(channelBlock);
+            chains[(size_t)ch].process(context);
+        }
+    });
+}
+
+juce::var toJSON(const juce::String& target, const BenchmarkCase& benchmarkCase, const Measurement& measurement)
+{
+    auto* result = new juce::DynamicObject();
+
+    result->setProperty("target", target);
+    result->setProperty("blockSize", benchmarkCase.blockSize);
+    result->setProperty("sampleRate", benchmarkCase.sampleRate);
+    result->setProperty("lowCutSlope", 12 * (benchmarkCase.lowCutSlope + 1));
+    result->setProperty("highCutSlope", 12 * (benchmarkCase.highCutSlope + 1));
+
+    juce::Array<juce::var> bypassed;
+    for ( size_t i = 0; i < bypassParameters.size(); ++i )
+        if ( (benchmarkCase.bypassMask >> i) & 1 )
+            bypassed.add(juce::String(bypassParameters[i]).upToFirstOccurrenceOf(" ", false, false));
+    result->setProperty("bypassed", bypassed);
+
+    // Per sample per channel, so mono and multichannel figures compare directly.
+    const auto numChannelSamples = (double)measurement.numSamples * numChannels;
+    result->setProperty("nsPerSample", measurement.seconds * 1.0e9 / numChannelSamples);
+    result->setProperty("cyclesPerSample", measurement.cycles > 0 ? juce::var((double)measurement.cycles / numChannelSamples) : juce::var());
+    result->setProperty("realTimeFactor", (measurement.numSamples / benchmarkCase.sampleRate) / measurement.seconds);
+
+    return juce::var(result);
+}
+
+juce::Array<BenchmarkCase> makeCases(bool full)
+{
+    juce::Array<BenchmarkCase> cases;
+
+    if ( full )
+    {
+        for ( auto sampleRate : sampleRates )
+            for ( auto blockSize : blockSizes )
+                for ( int low = 0; low < 4; ++low )
+                    for ( int high = 0; high < 4; ++high )
+                        for ( int mask = 0; mask < 32; ++mask )
+                            cases.add({ blockSize, sampleRate, (Slope)low, (Slope)high, mask });
+
+        return cases;
+    }
+
+    for ( auto sampleRate : sampleRates )
+        for ( auto blockSize : blockSizes )
+            cases.add({ blockSize, sampleRate, Slope::Slope_12, Slope::Slope_12, 0 });
+
+    for ( int low = 0; low < 4; ++low )
+        for ( int high = 0; high < 4; ++high )
+            cases.add({ 512, 48000.0, (Slope)low, (Slope)high, 0 });
+
+    for ( int mask = 0; mask < 32; ++mask )
+        cases.add({ 512, 48000.0, Slope::Slope_12, Slope::Slope_12, mask });
+
+    return cases;
+}
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    juce::ArgumentList args(argc, argv);
+
+    const auto full = args.containsOption("--full");
+    const auto secondsOfAudio = args.containsOption("--seconds") ? juce::jmax(0.01, args.getValueForOption("--seconds").getDoubleValue())
+                                                                 : 2.0;
+
+    // Enough noise to cycle through; comfortably more than the largest block.
+    juce::AudioBuffer<float> source(numChannels, 1 << 16);
+    juce::Random random(0x5eed);
+
+    for ( int ch = 0; ch < numChannels; ++ch )
+        for ( int i = 0; i < source.getNumSamples(); ++i )
+            source.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.25f);
+
+    const auto cases = makeCases(full);
+    juce::Array<juce::var> results;
+
+    for ( int i = 0; i < cases.size(); ++i )
+    {
+        const auto& benchmarkCase = cases.getReference(i);
+
+        results.add(toJSON("processBlock", benchmarkCase, measureProcessor(benchmarkCase, source, secondsOfAudio)));
+        results.add(toJSON("MonoChain", benchmarkCase, measureMonoChain(benchmarkCase, source, secondsOfAudio)));
+
+        std::cerr << "\r" << (i + 1) << " / " << cases.size() << std::flush;
+    }
+
+    std::cerr << std::endl;
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("juceVersion", juce::SystemStats::getJUCEVersion());
+    report->setProperty("cpu", juce::SystemStats::getCpuModel());
+    report->setProperty("buildDate", juce::String(__DATE__) + " " + __TIME__);
+   #if JUCE_DEBUG
+    report->setProperty("configuration", "Debug");
+   #else
+    report->setProperty("configuration", "Release");
+   #endif
+    report->setProperty("secondsOfAudioPerCase", secondsOfAudio);
+    report->setProperty("results", results);
+
+    const auto json = juce::JSON::toString(juce::var(report));
+
+    if ( args.containsOption("--output") )
+    {
+        auto output = args.getFileForOption("--output");
+
+        if ( ! output.replaceWithText(json) )
+        {
+            std::cerr << "Couldn't write " << output.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << json << std::endl;
+    }
+
+    return 0;
+}